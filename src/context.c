@@ -0,0 +1,505 @@
+/*******************************************************************************
+** context.c (render context)
+*******************************************************************************/
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "clock.h"
+#include "context.h"
+#include "datatree.h"
+#include "export.h"
+#include "parse.h"
+#include "shaping.h"
+
+/* the shared tables are generated at build time; the processor */
+/* specific functions are chosen once per process               */
+static pthread_once_t S_tables_once = PTHREAD_ONCE_INIT;
+
+/*******************************************************************************
+** idunno_context_generate_shared_tables()
+*******************************************************************************/
+static void idunno_context_generate_shared_tables()
+{
+  downsamp_generate_tables();
+  waveform_select_kernels();
+  reverb_select_kernels();
+  shaping_select_kernels();
+  exporter_select_kernels();
+}
+
+/*******************************************************************************
+** idunno_context_generate_tables()
+*******************************************************************************/
+short int idunno_context_generate_tables()
+{
+  if (pthread_once(&S_tables_once, idunno_context_generate_shared_tables))
+    return 1;
+
+  return 0;
+}
+
+/*******************************************************************************
+** idunno_context_init()
+*******************************************************************************/
+short int idunno_context_init(idunno_context* ctx)
+{
+  if (ctx == NULL)
+    return 1;
+
+  /* the shared tables are needed whichever way the context was made */
+  if (idunno_context_generate_tables())
+    return 1;
+
+  sequencer_init(&ctx->seq);
+  synth_init(&ctx->syn);
+
+  ctx->bpm = 120;
+
+  ctx->export_sampling = 44100;
+  ctx->export_period = 22676;
+  ctx->export_bitres = 16;
+
+  ctx->downsampling_m = 128;
+
+  ctx->tuning_system = TUNING_SYSTEM_12_ET;
+  ctx->tuning_fork = TUNING_FORK_A440;
+
+  /* the song dependent tables are computed on the first update */
+  ctx->tuning.tuning_system = -1;
+  ctx->tuning.tuning_fork = -1;
+
+  ctx->downsampling.export_sampling = 0;
+  ctx->downsampling.export_period = 0;
+  ctx->downsampling.m = 0;
+
+  downsampler_init(&ctx->dsmp);
+  ctx->out_index = 0;
+
+  ctx->num_threads = 1;
+  ctx->num_voices = SYNTH_DEFAULT_VOICES;
+  ctx->control_period = FILTER_DEFAULT_CONTROL_PERIOD;
+
+  ctx->sample_index = 0;
+  ctx->sample_buffer_size = 0;
+  ctx->export_buffer_size = 0;
+  ctx->time_elapsed = 0;
+
+  return 0;
+}
+
+/*******************************************************************************
+** idunno_context_create()
+*******************************************************************************/
+idunno_context* idunno_context_create()
+{
+  idunno_context* ctx;
+
+  ctx = malloc(sizeof(idunno_context));
+
+  if (ctx == NULL)
+    return NULL;
+
+  if (idunno_context_init(ctx))
+  {
+    free(ctx);
+    return NULL;
+  }
+
+  return ctx;
+}
+
+/*******************************************************************************
+** idunno_context_deinit()
+*******************************************************************************/
+short int idunno_context_deinit(idunno_context* ctx)
+{
+  if (ctx == NULL)
+    return 1;
+
+  sequencer_deinit(&ctx->seq);
+  synth_deinit(&ctx->syn);
+
+  downsampler_deinit(&ctx->dsmp);
+  ctx->out_index = 0;
+
+  ctx->sample_index = 0;
+  ctx->sample_buffer_size = 0;
+  ctx->export_buffer_size = 0;
+  ctx->time_elapsed = 0;
+
+  return 0;
+}
+
+/*******************************************************************************
+** idunno_context_destroy()
+*******************************************************************************/
+short int idunno_context_destroy(idunno_context* ctx)
+{
+  if (ctx == NULL)
+    return 1;
+
+  idunno_context_deinit(ctx);
+  free(ctx);
+
+  return 0;
+}
+
+/*******************************************************************************
+** idunno_context_reset()
+*******************************************************************************/
+short int idunno_context_reset(idunno_context* ctx)
+{
+  if (ctx == NULL)
+    return 1;
+
+  /* restore the default settings; the song dependent */
+  /* tables are kept until the settings change        */
+  sequencer_deinit(&ctx->seq);
+  synth_deinit(&ctx->syn);
+
+  sequencer_init(&ctx->seq);
+  synth_init(&ctx->syn);
+
+  ctx->bpm = 120;
+
+  ctx->export_sampling = 44100;
+  ctx->export_period = 22676;
+  ctx->export_bitres = 16;
+
+  ctx->downsampling_m = 128;
+
+  ctx->tuning_system = TUNING_SYSTEM_12_ET;
+  ctx->tuning_fork = TUNING_FORK_A440;
+
+  downsampler_deinit(&ctx->dsmp);
+  ctx->out_index = 0;
+
+  ctx->sample_index = 0;
+  ctx->sample_buffer_size = 0;
+  ctx->export_buffer_size = 0;
+  ctx->time_elapsed = 0;
+
+  return 0;
+}
+
+/*******************************************************************************
+** idunno_context_update_tables()
+*******************************************************************************/
+short int idunno_context_update_tables(idunno_context* ctx)
+{
+  if (ctx == NULL)
+    return 1;
+
+  if ((ctx->tuning_system != ctx->tuning.tuning_system) ||
+      (ctx->tuning_fork != ctx->tuning.tuning_fork))
+  {
+    if (tuning_compute_tables(&ctx->tuning,
+                              ctx->tuning_system, ctx->tuning_fork))
+    {
+      return 1;
+    }
+  }
+
+  if ((ctx->export_sampling != ctx->downsampling.export_sampling) ||
+      (ctx->downsampling_m != ctx->downsampling.m))
+  {
+    if (downsamp_compute_sinc_filter( &ctx->downsampling,
+                                      ctx->export_sampling,
+                                      ctx->export_period,
+                                      ctx->downsampling_m))
+    {
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** idunno_context_set_threads()
+*******************************************************************************/
+short int idunno_context_set_threads(idunno_context* ctx, int num_threads)
+{
+  if (ctx == NULL)
+    return 1;
+
+  if (num_threads < 1)
+    return 1;
+
+  /* the threads are started when the song is rewound */
+  ctx->num_threads = num_threads;
+
+  return 0;
+}
+
+/*******************************************************************************
+** idunno_context_set_voices()
+*******************************************************************************/
+short int idunno_context_set_voices(idunno_context* ctx, int num_voices)
+{
+  if (ctx == NULL)
+    return 1;
+
+  if ((num_voices < 1) || (num_voices > SYNTH_MAX_VOICES))
+    return 1;
+
+  /* the voice pool is resized when the song is rewound */
+  ctx->num_voices = num_voices;
+
+  return 0;
+}
+
+/*******************************************************************************
+** idunno_context_set_control_period()
+*******************************************************************************/
+short int idunno_context_set_control_period(idunno_context* ctx, 
+                                            int control_period)
+{
+  if (ctx == NULL)
+    return 1;
+
+  if ((control_period < 1) || (control_period > FILTER_MAX_CONTROL_PERIOD))
+    return 1;
+
+  /* the voices are updated when the song is rewound */
+  ctx->control_period = control_period;
+
+  return 0;
+}
+
+/*******************************************************************************
+** idunno_context_load_tree()
+*******************************************************************************/
+static short int idunno_context_load_tree(idunno_context*  ctx,
+                                          data_tree_node*  root)
+{
+  parse_data_tree_to_context(ctx, root);
+  data_tree_node_destroy_tree(root);
+
+  /* regenerate the song dependent tables if the settings changed */
+  if (idunno_context_update_tables(ctx))
+    return 1;
+
+  return idunno_context_rewind(ctx);
+}
+
+/*******************************************************************************
+** idunno_context_load_file()
+*******************************************************************************/
+short int idunno_context_load_file(idunno_context* ctx, char* filename)
+{
+  data_tree_node* root;
+
+  if ((ctx == NULL) || (filename == NULL))
+    return 1;
+
+  idunno_context_reset(ctx);
+
+  /* read input file */
+  root = parse_file_to_data_tree(filename);
+
+  if (root == NULL)
+  {
+    printf("Data tree not created from input file %s.\n", filename);
+    return 1;
+  }
+
+  return idunno_context_load_tree(ctx, root);
+}
+
+/*******************************************************************************
+** idunno_context_load_memory()
+*******************************************************************************/
+short int idunno_context_load_memory( idunno_context* ctx,
+                                      char* buffer, int size)
+{
+  data_tree_node* root;
+
+  if ((ctx == NULL) || (buffer == NULL))
+    return 1;
+
+  idunno_context_reset(ctx);
+
+  /* read input buffer */
+  root = parse_memory_to_data_tree(buffer, size);
+
+  if (root == NULL)
+  {
+    printf("Data tree not created from input buffer.\n");
+    return 1;
+  }
+
+  return idunno_context_load_tree(ctx, root);
+}
+
+/*******************************************************************************
+** idunno_context_rewind()
+*******************************************************************************/
+short int idunno_context_rewind(idunno_context* ctx)
+{
+  float export_length;
+
+  if (ctx == NULL)
+    return 1;
+
+  /* determine buffer sizes */
+  export_length = sequencer_calculate_length(&ctx->seq, ctx->bpm);
+
+  ctx->sample_buffer_size = (int) (export_length * GENESIS_PER_OP_FM_CLOCK);
+  ctx->export_buffer_size = (int) (export_length * ctx->export_sampling);
+
+  /* setup synth, reset sequencer and downsampler; a song whose */
+  /* synth was not set up is left with nothing to render          */
+  if (synth_setup(&ctx->syn, &ctx->tuning))
+  {
+    printf("Synth not set up for the song.\n");
+
+    ctx->sample_buffer_size = 0;
+    ctx->export_buffer_size = 0;
+
+    return 1;
+  }
+
+  synth_set_polyphony(&ctx->syn, ctx->num_voices);
+  synth_set_control_period(&ctx->syn, ctx->control_period);
+
+  if (synth_start_threads(&ctx->syn, ctx->num_threads))
+    printf("Worker threads not started. Rendering on one thread.\n");
+
+  sequencer_reset(&ctx->seq);
+
+  downsampler_reset(&ctx->dsmp, &ctx->downsampling, ctx->export_buffer_size);
+  ctx->out_index = 0;
+
+  /* sound generation start */
+  ctx->sample_index = 0;
+  ctx->time_elapsed = 0;
+
+  sequencer_activate_step(&ctx->seq, &ctx->syn);
+
+  return 0;
+}
+
+/*******************************************************************************
+** idunno_context_get_length()
+*******************************************************************************/
+int idunno_context_get_length(idunno_context* ctx)
+{
+  if (ctx == NULL)
+    return 0;
+
+  return ctx->export_buffer_size;
+}
+
+/*******************************************************************************
+** idunno_context_render_block()
+*******************************************************************************/
+static short int idunno_context_render_block(idunno_context* ctx)
+{
+  short int sample_buffer[SYNTH_BLOCK_SIZE];
+  int       num_frames;
+
+  /* determine the number of frames in this block; the block is */
+  /* cut short so that sequencer events land on the exact frame */
+  num_frames = 0;
+
+  while ( (num_frames < SYNTH_BLOCK_SIZE) &&
+          (ctx->sample_index + num_frames < ctx->sample_buffer_size))
+  {
+    /* update sequencer */
+    if (ctx->time_elapsed >= G_sequencer_period_table[ctx->bpm - 32])
+    {
+      if ((num_frames > 0) && sequencer_event_on_next_tick(&ctx->seq))
+        break;
+
+      sequencer_ahead_one_tick(&ctx->seq, &ctx->syn);
+      ctx->time_elapsed -= G_sequencer_period_table[ctx->bpm - 32];
+    }
+
+    num_frames += 1;
+
+    /* update time elapsed */
+    ctx->time_elapsed += GENESIS_DELTA_T_NANOSECONDS;
+  }
+
+  /* update synth (the samples are clipped to 16 bits) */
+  if (synth_render_block(&ctx->syn, sample_buffer, num_frames))
+    return 1;
+
+  /* downsample */
+  downsampler_process_block(&ctx->dsmp, sample_buffer, num_frames);
+
+  ctx->sample_index += num_frames;
+
+  return 0;
+}
+
+/*******************************************************************************
+** idunno_context_render()
+*******************************************************************************/
+int idunno_context_render(idunno_context* ctx,
+                          short int* buffer, int num_frames)
+{
+  int num_written;
+  int num_copied;
+
+  /* returns the number of frames written (0 at the end of */
+  /* the song), or -1 if the song could not be rendered    */
+  if ((ctx == NULL) || (buffer == NULL))
+    return -1;
+
+  num_written = 0;
+
+  while (num_written < num_frames)
+  {
+    /* copy the samples left over from the previous block */
+    if (ctx->out_index < ctx->dsmp.num_out)
+    {
+      num_copied = ctx->dsmp.num_out - ctx->out_index;
+
+      if (num_copied > num_frames - num_written)
+        num_copied = num_frames - num_written;
+
+      memcpy( &buffer[num_written], &ctx->dsmp.out_buffer[ctx->out_index],
+              num_copied * sizeof(short int));
+
+      ctx->out_index += num_copied;
+      num_written += num_copied;
+
+      continue;
+    }
+
+    /* render the next block, or drain the downsampler at the end */
+    ctx->out_index = 0;
+
+    if (ctx->sample_index < ctx->sample_buffer_size)
+    {
+      /* a block that could not be rendered fails the render */
+      if (idunno_context_render_block(ctx))
+      {
+        ctx->out_index = ctx->dsmp.num_out;
+        synth_stop_threads(&ctx->syn);
+
+        return -1;
+      }
+    }
+    else
+    {
+      downsampler_flush(&ctx->dsmp);
+
+      /* the worker threads are not needed once the song is finished */
+      if (ctx->dsmp.num_out == 0)
+      {
+        synth_stop_threads(&ctx->syn);
+        break;
+      }
+    }
+  }
+
+  return num_written;
+}
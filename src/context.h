@@ -0,0 +1,78 @@
+/*******************************************************************************
+** context.h (render context)
+*******************************************************************************/
+
+#ifndef CONTEXT_H
+#define CONTEXT_H
+
+#include "downsamp.h"
+#include "sequence.h"
+#include "synth.h"
+#include "tuning.h"
+
+typedef struct idunno_context
+{
+  /* sequencer and synth */
+  sequencer           seq;
+  synth               syn;
+
+  /* tempo */
+  int                 bpm;
+
+  /* export settings */
+  int                 export_sampling;
+  int                 export_period;
+  int                 export_bitres;
+
+  int                 downsampling_m;
+
+  /* tuning settings */
+  int                 tuning_system;
+  int                 tuning_fork;
+
+  /* tables that depend on the settings (the other tables are shared) */
+  tuning_tables       tuning;
+  downsampling_filter downsampling;
+
+  /* downsampler (output samples are read from its buffer) */
+  downsampler         dsmp;
+  int                 out_index;
+
+  /* render position */
+  int                 num_threads;
+  int                 num_voices;
+  int                 control_period;
+
+  int                 sample_index;
+  int                 sample_buffer_size;
+  int                 export_buffer_size;
+  int                 time_elapsed;
+} idunno_context;
+
+/* function declarations; a song is loaded into a context, and  */
+/* then rendered in pieces until no more frames are returned     */
+short int       idunno_context_init(idunno_context* ctx);
+idunno_context* idunno_context_create();
+short int       idunno_context_deinit(idunno_context* ctx);
+short int       idunno_context_destroy(idunno_context* ctx);
+
+short int       idunno_context_generate_tables();
+
+short int       idunno_context_reset(idunno_context* ctx);
+short int       idunno_context_update_tables(idunno_context* ctx);
+
+short int       idunno_context_set_threads(idunno_context* ctx, int num_threads);
+short int       idunno_context_set_voices(idunno_context* ctx, int num_voices);
+short int       idunno_context_set_control_period(idunno_context* ctx, 
+                                                  int control_period);
+
+short int       idunno_context_load_file(idunno_context* ctx, char* filename);
+short int       idunno_context_load_memory( idunno_context* ctx, 
+                                            char* buffer, int size);
+
+short int       idunno_context_rewind(idunno_context* ctx);
+int             idunno_context_get_length(idunno_context* ctx);
+int             idunno_context_render(idunno_context* ctx, 
+                                      short int* buffer, int num_frames);
+
+#endif
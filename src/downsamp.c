@@ -7,106 +7,366 @@
 #include <string.h>
 #include <math.h>
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DOWNSAMP_X86_SIMD
+#include <immintrin.h>
+#endif
+
 #include "clock.h"
 #include "downsamp.h"
 #include "global.h"
 
-float G_downsampling_kernel[(DOWNSAMPLING_M_MAX / 2) + 1];
+/* The convolution is summed in 8 interleaved partial sums, which are   */
+/* then added in a fixed order. Every version below uses this order,   */
+/* so the output does not depend on which one is chosen. Compared to a  */
+/* single running sum, the result differs only by float rounding        */
+/* (well under 1 lsb before the output is rounded to 16 bits).          */
+
+/*******************************************************************************
+** downsamp_convolve_scalar()
+*******************************************************************************/
+static float downsamp_convolve_scalar(float* kernel, short int* window, int num_taps)
+{
+  int i;
+  int j;
+
+  float acc[8];
+
+  for (j = 0; j < 8; j++)
+    acc[j] = 0.0f;
+
+  for (i = 0; i < num_taps; i += 8)
+  {
+    for (j = 0; j < 8; j++)
+      acc[j] += kernel[i + j] * window[i + j];
+  }
+
+  return  ((acc[0] + acc[4]) + (acc[2] + acc[6])) + 
+          ((acc[1] + acc[5]) + (acc[3] + acc[7]));
+}
+
+/* convolution function (the scalar version is used until the tables */
+/* are generated)                                                    */
+static float (*S_downsamp_convolve)(float* kernel, short int* window,
+                                    int num_taps) = downsamp_convolve_scalar;
+
+#ifdef DOWNSAMP_X86_SIMD
+/*******************************************************************************
+** downsamp_convolve_sse2()
+*******************************************************************************/
+__attribute__((target("sse2")))
+static float downsamp_convolve_sse2(float* kernel, short int* window, int num_taps)
+{
+  int i;
+
+  __m128i x;
+  __m128  acc_lo;
+  __m128  acc_hi;
+  __m128  sum;
+
+  acc_lo = _mm_setzero_ps();
+  acc_hi = _mm_setzero_ps();
+
+  for (i = 0; i < num_taps; i += 8)
+  {
+    /* sign extend the samples to 32 bits and convert to float */
+    x = _mm_loadu_si128((__m128i*) &window[i]);
+
+    acc_lo = _mm_add_ps(acc_lo, 
+                        _mm_mul_ps( _mm_loadu_ps(&kernel[i]), 
+                                    _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16))));
+    acc_hi = _mm_add_ps(acc_hi, 
+                        _mm_mul_ps( _mm_loadu_ps(&kernel[i + 4]), 
+                                    _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16))));
+  }
+
+  sum = _mm_add_ps(acc_lo, acc_hi);
+  sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+  sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+
+  return _mm_cvtss_f32(sum);
+}
+
+/*******************************************************************************
+** downsamp_convolve_avx2()
+*******************************************************************************/
+__attribute__((target("avx2")))
+static float downsamp_convolve_avx2(float* kernel, short int* window, int num_taps)
+{
+  int i;
+
+  __m256  acc;
+  __m128  sum;
+
+  acc = _mm256_setzero_ps();
+
+  for (i = 0; i < num_taps; i += 8)
+  {
+    acc = _mm256_add_ps(acc, 
+                        _mm256_mul_ps(_mm256_loadu_ps(&kernel[i]), 
+                                      _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128((__m128i*) &window[i])))));
+  }
+
+  sum = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+  sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+  sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+
+  return _mm_cvtss_f32(sum);
+}
+#endif
+
+/*******************************************************************************
+** downsamp_generate_tables()
+*******************************************************************************/
+short int downsamp_generate_tables()
+{
+  /* choose the convolution function for this processor */
+  S_downsamp_convolve = downsamp_convolve_scalar;
+
+#ifdef DOWNSAMP_X86_SIMD
+  __builtin_cpu_init();
+
+  if (__builtin_cpu_supports("avx2"))
+    S_downsamp_convolve = downsamp_convolve_avx2;
+  else if (__builtin_cpu_supports("sse2"))
+    S_downsamp_convolve = downsamp_convolve_sse2;
+#endif
+
+  return 0;
+}
 
 /*******************************************************************************
 ** downsamp_compute_sinc_filter()
 *******************************************************************************/
-short int downsamp_compute_sinc_filter()
+short int downsamp_compute_sinc_filter( downsampling_filter* f, 
+                                        int export_sampling, 
+                                        int export_period, 
+                                        int m)
 {
   int i;
+  int k;
 
   float fc;
   float sum;
 
+  float x;
+  float w;
+
+  float* kernel;
+
+  if (f == NULL)
+    return 1;
+
+  if ((m <= 0) || (m > DOWNSAMPLING_M_MAX))
+    return 1;
+
+  f->export_sampling = export_sampling;
+  f->export_period = export_period;
+  f->m = m;
+
   /* the cutoff frequency is a fraction of the sampling rate */
-  fc = (G_export_sampling / 2.0f) / GENESIS_PER_OP_FM_CLOCK;
+  fc = (export_sampling / 2.0f) / GENESIS_PER_OP_FM_CLOCK;
 
   /* shift fc so that the transition band ends at the intended frequency */
-  fc -= 2.0f / (float) G_downsampling_m;
+  fc -= 2.0f / (float) m;
 
   /* The equation is from Steven W. Smith's The Scientist and Engineer's  */
   /* Guide to Digital Signal Processing, page 290 (Ch. 16)                */
 
-  /* sinc filter */
-  for (i = 0; i < G_downsampling_bound; i++)
+  /* each phase is the sinc filter delayed by a fraction of a sample, */
+  /* so tap i of phase k is applied to the input sample that is       */
+  /* (i - m/2) samples from the one preceding the output instant      */
+  for (k = 0; k < DOWNSAMPLING_NUM_PHASES; k++)
   {
-    if (i == G_downsampling_m / 2)
-      G_downsampling_kernel[i] = TWO_PI * fc;
-    else
+    kernel = f->kernel[k];
+
+    for (i = 0; i < DOWNSAMPLING_KERNEL_SIZE; i++)
     {
-      G_downsampling_kernel[i] = sin(TWO_PI * fc * (i - G_downsampling_m / 2)) / (i - G_downsampling_m / 2);
-      G_downsampling_kernel[i] *= 0.42  - 0.5 * cos(TWO_PI * i / (float) G_downsampling_m)
-                                  + 0.08 * cos(2 * TWO_PI * i / (float) G_downsampling_m);
+      /* position in the window */
+      w = i - (k / (float) DOWNSAMPLING_NUM_PHASES);
+
+      /* offset from the center of the window */
+      x = w - (m / 2);
+
+      if ((w < 0.0f) || (i > m))
+        kernel[i] = 0.0f;
+      else if (k == 0 && i == m / 2)
+        kernel[i] = TWO_PI * fc;
+      else
+      {
+        kernel[i] = sin(TWO_PI * fc * x) / x;
+        kernel[i] *= 0.42 - 0.5 * cos(TWO_PI * w / (float) m)
+                          + 0.08 * cos(2 * TWO_PI * w / (float) m);
+      }
     }
-  }
 
-  /* normalization */
-  sum = G_downsampling_kernel[G_downsampling_m / 2];
+    /* normalization */
+    sum = 0.0f;
 
-  for (i = 0; i < G_downsampling_bound - 1; i++)
-    sum += 2 * G_downsampling_kernel[i];
+    for (i = 0; i <= m; i++)
+      sum += kernel[i];
 
-  for (i = 0; i < G_downsampling_bound; i++)
-    G_downsampling_kernel[i] /= sum;
+    for (i = 0; i <= m; i++)
+      kernel[i] /= sum;
+  }
 
 #if 0
   /* testing: check filter values */
-  for (i = 0; i < G_downsampling_bound; i++)
-    fprintf(stdout, "Sinc Filter value: %f\n", G_downsampling_kernel[i]);
+  for (i = 0; i <= m; i++)
+    fprintf(stdout, "Sinc Filter value: %f\n", f->kernel[0][i]);
 #endif
 
   return 0;
 }
 
 /*******************************************************************************
-** downsamp_apply_filter()
+** downsampler_init()
 *******************************************************************************/
-short int downsamp_apply_filter(short int* buffer, int size)
+short int downsampler_init(downsampler* ds)
 {
-  int i;
-  int j;
+  if (ds == NULL)
+    return 1;
 
-  int low_bound;
-  int high_bound;
+  ds->f = NULL;
 
-  float val;
+  ds->history_size = 0;
+  ds->num_out = 0;
+
+  ds->export_buffer_size = 0;
+  ds->export_index = 0;
+
+  ds->sample_index = 0;
+  ds->export_elapsed = 0;
+
+  ds->bypass = 0;
+
+  return 0;
+}
 
-  short int* tmp_buffer;
+/*******************************************************************************
+** downsampler_create()
+*******************************************************************************/
+downsampler* downsampler_create()
+{
+  downsampler* ds;
 
-  /* allocate temporary buffer */
-  tmp_buffer = malloc(sizeof(short int) * size);
+  ds = malloc(sizeof(downsampler));
+  downsampler_init(ds);
 
-  if (tmp_buffer == NULL)
+  return ds;
+}
+
+/*******************************************************************************
+** downsampler_deinit()
+*******************************************************************************/
+short int downsampler_deinit(downsampler* ds)
+{
+  if (ds == NULL)
     return 1;
 
-  /* time domain convolution */
-  for (i = 0; i < size; i++)
-  {
-    /* determine bounds */
-    low_bound = i - (G_downsampling_m / 2);
-    high_bound = i + (G_downsampling_m / 2);
+  ds->f = NULL;
+
+  ds->history_size = 0;
+  ds->num_out = 0;
+
+  return 0;
+}
+
+/*******************************************************************************
+** downsampler_destroy()
+*******************************************************************************/
+short int downsampler_destroy(downsampler* ds)
+{
+  if (ds == NULL)
+    return 1;
+
+  downsampler_deinit(ds);
+  free(ds);
+
+  return 0;
+}
+
+/*******************************************************************************
+** downsampler_reset()
+*******************************************************************************/
+short int downsampler_reset(downsampler*         ds, 
+                            downsampling_filter*  f, 
+                            int                   export_buffer_size)
+{
+  int i;
+
+  if ((ds == NULL) || (f == NULL))
+    return 1;
+
+  ds->f = f;
+
+  /* the history starts with m/2 zeros, so that the */
+  /* first output sample is centered on sample 0    */
+  for (i = 0; i < DOWNSAMPLING_KERNEL_SIZE + DOWNSAMPLING_BLOCK_SIZE; i++)
+    ds->history[i] = 0;
+
+  ds->history_size = f->m / 2;
+
+  ds->num_out = 0;
 
-    if (low_bound < 0)
-      low_bound = 0;
+  ds->export_buffer_size = export_buffer_size;
+  ds->export_index = 0;
 
-    if (high_bound > size - 1)
-      high_bound = size - 1;
+  ds->sample_index = 0;
+  ds->export_elapsed = 0;
 
-    /* perform convolution with filter kernel */
-    val = 0.0f;
+  /* no filtering at the internal sampling rate */
+  if (f->export_sampling == 53267)
+    ds->bypass = 1;
+  else
+    ds->bypass = 0;
+
+  return 0;
+}
+
+/*******************************************************************************
+** downsampler_filter()
+*******************************************************************************/
+static void downsampler_filter(downsampler* ds)
+{
+  int phase;
+
+  downsampling_filter* f;
+
+  float val;
 
-    for (j = low_bound; j <= high_bound; j++)
+  float*      kernel;
+  short int*  window;
+
+  f = ds->f;
+
+  /* the filter is only evaluated at the output instants; the */
+  /* output falls export_elapsed after the sample at the      */
+  /* center of the window, and the nearest phase is used      */
+  while ( (ds->export_index < ds->export_buffer_size) && 
+          (ds->num_out < DOWNSAMPLING_OUTPUT_SIZE))
+  {
+    phase = ((ds->export_elapsed * DOWNSAMPLING_NUM_PHASES) + 
+             (GENESIS_DELTA_T_NANOSECONDS / 2)) / GENESIS_DELTA_T_NANOSECONDS;
+
+    /* wait for the rest of the window */
+    if (ds->sample_index + f->m + (phase / DOWNSAMPLING_NUM_PHASES) >= ds->history_size)
+      break;
+
+    if (phase < DOWNSAMPLING_NUM_PHASES)
     {
-      if (j <= i)
-        val += G_downsampling_kernel[j - i + (G_downsampling_m / 2)] * buffer[j];
-      else
-        val += G_downsampling_kernel[i - j + (G_downsampling_m / 2)] * buffer[j];
+      kernel = f->kernel[phase];
+      window = &ds->history[ds->sample_index];
     }
+    else
+    {
+      kernel = f->kernel[0];
+      window = &ds->history[ds->sample_index + 1];
+    }
+
+    /* perform convolution with filter kernel; the padding taps */
+    /* are zero, so the extra samples read here have no effect  */
+    val = S_downsamp_convolve(kernel, window, f->m + 8);
 
     /* bound val */
     if (val > 32767)
@@ -114,76 +374,96 @@ short int downsamp_apply_filter(short int* buffer, int size)
     else if (val < -32767)
       val = -32767;
 
-    /* write sample to temporary buffer */
-    tmp_buffer[i] = (short int) (val + 0.5);
-  }
+    ds->out_buffer[ds->num_out++] = (short int) (val + 0.5);
+    ds->export_index += 1;
 
-  /* copy temporary buffer to the sample buffer */
-  memcpy(buffer, tmp_buffer, sizeof(short int) * size);
+    /* advance to the next output instant */
+    ds->export_elapsed += f->export_period;
 
-  /* free temporary buffer */
-  if (tmp_buffer != NULL)
-  {
-    free(tmp_buffer);
-    tmp_buffer = NULL;
+    while (ds->export_elapsed >= GENESIS_DELTA_T_NANOSECONDS)
+    {
+      ds->export_elapsed -= GENESIS_DELTA_T_NANOSECONDS;
+      ds->sample_index += 1;
+    }
   }
 
-  return 0;
+  /* discard the samples that are no longer needed */
+  memmove(&ds->history[0], &ds->history[ds->sample_index], 
+          sizeof(short int) * (ds->history_size - ds->sample_index));
+
+  ds->history_size -= ds->sample_index;
+  ds->sample_index = 0;
+
+  return;
 }
 
 /*******************************************************************************
-** downsamp_perform_downsample()
+** downsampler_process_block()
 *******************************************************************************/
-short int downsamp_perform_downsample(short int*  sample_buffer, 
-                                      int         sample_buffer_size, 
-                                      short int*  export_buffer, 
-                                      int         export_buffer_size)
+short int downsampler_process_block(downsampler*  ds, 
+                                    short int*    buffer, 
+                                    int           num_samples)
 {
   int i;
 
-  int sample_elapsed;
-  int export_elapsed;
+  if ((ds == NULL) || (ds->f == NULL))
+    return 1;
 
-  int sample_index;
+  ds->num_out = 0;
 
-  float weight;
+  if ((num_samples <= 0) || (num_samples > DOWNSAMPLING_BLOCK_SIZE))
+    return 1;
 
-  /* initialize variables */
-  sample_elapsed = 0;
-  export_elapsed = 0;
+  /* at the internal sampling rate, the samples are passed through */
+  if (ds->bypass)
+  {
+    for (i = 0; (i < num_samples) && (ds->export_index < ds->export_buffer_size); i++)
+      ds->out_buffer[ds->num_out++] = buffer[i];
 
-  sample_index = 0;
+    ds->export_index += ds->num_out;
 
-  weight = 0.0f;
+    return 0;
+  }
 
-  /* linear interpolation */
-  export_buffer[0] = sample_buffer[0];
+  /* ignore any samples past the end of the output */
+  if (ds->export_index >= ds->export_buffer_size)
+    return 0;
 
-  for (i = 1; i < export_buffer_size; i++)
-  {
-    export_elapsed += G_export_period;
+  /* append samples to history */
+  memcpy(&ds->history[ds->history_size], buffer, sizeof(short int) * num_samples);
+  ds->history_size += num_samples;
 
-    while (sample_elapsed + GENESIS_DELTA_T_NANOSECONDS < export_elapsed)
-    {
-      sample_elapsed += GENESIS_DELTA_T_NANOSECONDS;
-      sample_index += 1;
-    }
+  downsampler_filter(ds);
 
-    if (sample_index >= sample_buffer_size - 1)
-    {
-      export_buffer[i] = sample_buffer[sample_buffer_size - 1];
-      continue;
-    }
+  return 0;
+}
 
-    export_elapsed -= sample_elapsed;
-    sample_elapsed = 0;
+/*******************************************************************************
+** downsampler_flush()
+*******************************************************************************/
+short int downsampler_flush(downsampler* ds)
+{
+  int i;
+
+  if ((ds == NULL) || (ds->f == NULL))
+    return 1;
+
+  ds->num_out = 0;
 
-    weight = (float) export_elapsed / GENESIS_DELTA_T_NANOSECONDS;
+  if (ds->bypass)
+    return 0;
 
-    export_buffer[i] = (short int) (((1.0f - weight) * sample_buffer[sample_index]) + 
-                                    (weight * sample_buffer[sample_index + 1]) + 0.5f);
+  /* pad the end of the input with zeros until */
+  /* all of the output samples are computed    */
+  if (ds->export_index < ds->export_buffer_size)
+  {
+    for (i = 0; i < DOWNSAMPLING_BLOCK_SIZE; i++)
+      ds->history[ds->history_size + i] = 0;
+
+    ds->history_size += DOWNSAMPLING_BLOCK_SIZE;
+
+    downsampler_filter(ds);
   }
 
   return 0;
 }
-
@@ -7,14 +7,67 @@
 
 #define DOWNSAMPLING_M_MAX 512
 
-extern float G_downsampling_kernel[];
+/* number of fractional phases in the polyphase filter bank */
+#define DOWNSAMPLING_NUM_PHASES   256
+
+/* each phase is padded with zero taps to a multiple of 8 */
+#define DOWNSAMPLING_KERNEL_SIZE  (DOWNSAMPLING_M_MAX + 8)
+
+#define DOWNSAMPLING_BLOCK_SIZE   256
+#define DOWNSAMPLING_OUTPUT_SIZE  (2 * DOWNSAMPLING_BLOCK_SIZE)
+
+/* polyphase filter for an export sampling rate and filter length */
+typedef struct downsampling_filter
+{
+  int   export_sampling;
+  int   export_period;
+  int   m;
+
+  float kernel[DOWNSAMPLING_NUM_PHASES][DOWNSAMPLING_KERNEL_SIZE];
+} downsampling_filter;
+
+typedef struct downsampler
+{
+  /* filter */
+  downsampling_filter*  f;
+
+  /* input history (the window for the next output starts at sample_index) */
+  short int history[DOWNSAMPLING_KERNEL_SIZE + DOWNSAMPLING_BLOCK_SIZE];
+  int       history_size;
+
+  /* output samples from the most recent call */
+  short int out_buffer[DOWNSAMPLING_OUTPUT_SIZE];
+  int       num_out;
+
+  int       export_buffer_size;
+  int       export_index;
+
+  /* position of the next output sample */
+  int       sample_index;
+  int       export_elapsed;
+
+  int       bypass;
+} downsampler;
 
 /* function declarations */
-short int downsamp_compute_sinc_filter();
-short int downsamp_apply_filter(short int* buffer, int size);
-short int downsamp_perform_downsample(short int*  sample_buffer, 
-                                      int         sample_buffer_size, 
-                                      short int*  export_buffer, 
-                                      int         export_buffer_size);
+short int     downsampler_init(downsampler* ds);
+downsampler*  downsampler_create();
+short int     downsampler_deinit(downsampler* ds);
+short int     downsampler_destroy(downsampler* ds);
+
+short int     downsampler_reset(downsampler*         ds, 
+                                downsampling_filter*  f, 
+                                int                   export_buffer_size);
+
+short int     downsampler_process_block(downsampler*  ds, 
+                                        short int*    buffer, 
+                                        int           num_samples);
+short int     downsampler_flush(downsampler* ds);
+
+short int     downsamp_generate_tables();
+short int     downsamp_compute_sinc_filter( downsampling_filter* f, 
+                                            int export_sampling, 
+                                            int export_period, 
+                                            int m);
 
 #endif
@@ -373,3 +373,137 @@ short int envelope_update(envelope* e)
   return 0;
 }
 
+/*******************************************************************************
+** envelope_is_frozen()
+*******************************************************************************/
+static int envelope_is_frozen(envelope* e)
+{
+  unsigned char rate_index;
+
+  /* the attack always ends in a state change */
+  if (e->state == ENVELOPE_STATE_ATTACK)
+    return 0;
+
+  /* sustain & release stop changing at full attenuation (the decay */
+  /* can overshoot it, and the next step then brings it back down)   */
+  if ((e->state == ENVELOPE_STATE_SUSTAIN) || 
+      (e->state == ENVELOPE_STATE_RELEASE))
+  {
+    if (e->attenuation == 1023)
+      return 1;
+    else if (e->attenuation > 1023)
+      return 0;
+  }
+
+  /* decay stops changing when it reaches the sustain level */
+  if ((e->state == ENVELOPE_STATE_DECAY) && 
+      (e->attenuation >= e->sustain_bound))
+  {
+    return 0;
+  }
+
+  /* the two slowest rates never change the attenuation */
+  if (e->state == ENVELOPE_STATE_DECAY)
+    rate_index = e->d_index;
+  else if (e->state == ENVELOPE_STATE_SUSTAIN)
+    rate_index = e->s_index;
+  else
+    rate_index = e->r_index;
+
+  if (rate_index <= 1)
+    return 1;
+
+  return 0;
+}
+
+/*******************************************************************************
+** envelope_samples_until_change()
+*******************************************************************************/
+int envelope_samples_until_change(envelope* e, int max_samples)
+{
+  int num_samples;
+
+  if (e == NULL)
+    return 0;
+
+  /* the attenuation & state can change on the next update */
+  if ((e->state == ENVELOPE_STATE_ATTACK) && (e->a_index >= 62))
+    return 0;
+
+  if (e->cycles >= e->period)
+    return 0;
+
+  /* neither the attenuation nor the state change anymore */
+  if (envelope_is_frozen(e))
+    return max_samples;
+
+  /* the updates before the next step leave the attenuation as is */
+  num_samples = e->period - e->cycles - 1;
+
+  if (num_samples > max_samples)
+    num_samples = max_samples;
+
+  return num_samples;
+}
+
+/*******************************************************************************
+** envelope_advance()
+*******************************************************************************/
+short int envelope_advance(envelope* e, int num_samples)
+{
+  int num_steps;
+
+  if (e == NULL)
+    return 1;
+
+  if (num_samples <= 0)
+    return 0;
+
+  /* same as num_samples updates that do not change the attenuation */
+  /* or the state (see envelope_samples_until_change)                */
+  e->cycles += num_samples;
+
+  num_steps = e->cycles / e->period;
+
+  e->cycles -= num_steps * e->period;
+  e->increment_index = (e->increment_index + num_steps) % 8;
+
+  return 0;
+}
+
+/*******************************************************************************
+** envelope_render_block()
+*******************************************************************************/
+short int envelope_render_block(envelope* e, int* attenuation, int num_samples)
+{
+  int i;
+  int j;
+  int m;
+
+  if (e == NULL)
+    return 1;
+
+  for (i = 0; i < num_samples; i += m)
+  {
+    m = envelope_samples_until_change(e, num_samples - i);
+
+    /* constant stretch */
+    if (m > 0)
+    {
+      for (j = 0; j < m; j++)
+        attenuation[i + j] = e->attenuation;
+
+      envelope_advance(e, m);
+    }
+    /* step */
+    else
+    {
+      envelope_update(e);
+      attenuation[i] = e->attenuation;
+
+      m = 1;
+    }
+  }
+
+  return 0;
+}
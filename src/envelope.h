@@ -50,4 +50,8 @@ short int   envelope_setup( envelope* e,
 short int   envelope_change_state(envelope* e, int state);
 short int   envelope_update(envelope* e);
 
+int         envelope_samples_until_change(envelope* e, int max_samples);
+short int   envelope_advance(envelope* e, int num_samples);
+short int   envelope_render_block(envelope* e, int* attenuation, int num_samples);
+
 #endif
@@ -2,216 +2,911 @@
 ** export.c (file export functions)
 *******************************************************************************/
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 
+#include <pthread.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define EXPORTER_X86_SIMD
+#include <immintrin.h>
+#endif
+
 #include "export.h"
-#include "global.h"
 
-static FILE*          S_export_fp;
+/* the samples are converted into the staging buffer a block at a time, */
+/* and the buffer is written out in large pieces. the wav fields are    */
+/* little endian, so they are stored byte by byte on any host.          */
+
+/* with the writer thread running, the full staging buffers are queued  */
+/* and written in order by the writer, while the calling thread goes on */
+/* converting into the next free buffer. it only waits when all of the  */
+/* buffers are queued.                                                  */
+typedef struct exporter_thread
+{
+  pthread_t       thread;
+
+  /* the mutex guards the queue; the condition is signalled */
+  /* whenever a buffer is queued or written, or on quit      */
+  pthread_mutex_t mutex;
+  pthread_cond_t  cond;
 
-static unsigned int   S_chunk_size;
-static unsigned int   S_subchunk1_size;
-static unsigned int   S_subchunk2_size;
+  unsigned char*  buffer[EXPORTER_NUM_BUFFERS];
+  int             num_bytes[EXPORTER_NUM_BUFFERS];
 
-static unsigned int   S_byte_rate;
-static unsigned short S_audio_format;
-static unsigned short S_block_align;
+  /* the queued buffers run from the write index to the fill index */
+  int             fill_index;
+  int             write_index;
+  int             num_queued;
+
+  int             error;
+  int             quit;
+} exporter_thread;
+
+/*******************************************************************************
+** exporter_put_u16()
+*******************************************************************************/
+static void exporter_put_u16(unsigned char* p, unsigned int val)
+{
+  p[0] = val & 0xFF;
+  p[1] = (val >> 8) & 0xFF;
+}
+
+/*******************************************************************************
+** exporter_put_u32()
+*******************************************************************************/
+static void exporter_put_u32(unsigned char* p, unsigned int val)
+{
+  p[0] = val & 0xFF;
+  p[1] = (val >> 8) & 0xFF;
+  p[2] = (val >> 16) & 0xFF;
+  p[3] = (val >> 24) & 0xFF;
+}
+
+/*******************************************************************************
+** exporter_convert_8()
+*******************************************************************************/
+static void exporter_convert_8(short int* buffer, unsigned char* out, int num_samples)
+{
+  int i;
 
-static unsigned int   S_sampling_rate;
-static unsigned short S_bits_per_sample;
-static unsigned short S_num_channels;
+  for (i = 0; i < num_samples; i++)
+    out[i] = 127 - (buffer[i] / 256);
+}
+
+/*******************************************************************************
+** exporter_convert_16()
+*******************************************************************************/
+static void exporter_convert_16(short int* buffer, unsigned char* out, int num_samples)
+{
+  int i;
+
+  for (i = 0; i < num_samples; i++)
+    exporter_put_u16(&out[2 * i], (unsigned short int) buffer[i]);
+}
+
+/*******************************************************************************
+** exporter_copy_16()
+*******************************************************************************/
+static void exporter_copy_16(short int* buffer, unsigned char* out, int num_samples)
+{
+  /* on little endian hosts, the samples are already in wav order */
+  memcpy(out, buffer, 2 * num_samples);
+}
+
+/*******************************************************************************
+** exporter_convert_24()
+*******************************************************************************/
+static void exporter_convert_24(short int* buffer, unsigned char* out, int num_samples)
+{
+  int i;
+
+  for (i = 0; i < num_samples; i++)
+  {
+    out[3 * i + 0] = 0;
+    out[3 * i + 1] = buffer[i] & 0xFF;
+    out[3 * i + 2] = (buffer[i] >> 8) & 0xFF;
+  }
+}
 
 /*******************************************************************************
-** export_init()
+** exporter_convert_float()
 *******************************************************************************/
-short int export_init()
+static void exporter_convert_float(short int* buffer, unsigned char* out, int num_samples)
 {
-  S_export_fp = NULL;
+  int i;
 
-  S_chunk_size = 0;
-  S_subchunk1_size = 0;
-  S_subchunk2_size = 0;
+  float         val;
+  unsigned int  bits;
+
+  for (i = 0; i < num_samples; i++)
+  {
+    val = buffer[i] / 32768.0f;
+
+    memcpy(&bits, &val, 4);
+    exporter_put_u32(&out[4 * i], bits);
+  }
+}
+
+/* conversion kernels (the scalar versions are used until the kernels */
+/* are selected)                                                      */
+static void (*S_exporter_convert_8)(short int* buffer, unsigned char* out,
+                                    int num_samples) = exporter_convert_8;
+
+static void (*S_exporter_convert_16)( short int* buffer, unsigned char* out,
+                                      int num_samples) = exporter_convert_16;
+
+static void (*S_exporter_convert_24)( short int* buffer, unsigned char* out,
+                                      int num_samples) = exporter_convert_24;
+
+static void (*S_exporter_convert_float)(short int* buffer, unsigned char* out,
+                                        int num_samples) = exporter_convert_float;
+
+#ifdef EXPORTER_X86_SIMD
+/*******************************************************************************
+** exporter_convert_8_avx2()
+*******************************************************************************/
+__attribute__((target("avx2")))
+static void exporter_convert_8_avx2(short int* buffer, unsigned char* out, int num_samples)
+{
+  int i;
+
+  __m256i a;
+  __m256i b;
+  __m256i round;
+  __m256i center;
+
+  round = _mm256_set1_epi16(255);
+  center = _mm256_set1_epi16(127);
+
+  /* 32 samples at a time; the division by 256 rounds towards zero */
+  for (i = 0; i + 32 <= num_samples; i += 32)
+  {
+    a = _mm256_loadu_si256((__m256i*) &buffer[i]);
+    b = _mm256_loadu_si256((__m256i*) &buffer[i + 16]);
+
+    a = _mm256_add_epi16(a, _mm256_and_si256(_mm256_srai_epi16(a, 15), round));
+    b = _mm256_add_epi16(b, _mm256_and_si256(_mm256_srai_epi16(b, 15), round));
+
+    a = _mm256_sub_epi16(center, _mm256_srai_epi16(a, 8));
+    b = _mm256_sub_epi16(center, _mm256_srai_epi16(b, 8));
+
+    /* the pack works within each 128 bit lane, so the lanes are reordered */
+    a = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8);
+
+    _mm256_storeu_si256((__m256i*) &out[i], a);
+  }
+
+  /* remaining samples */
+  exporter_convert_8(&buffer[i], &out[i], num_samples - i);
+}
+
+/*******************************************************************************
+** exporter_convert_24_avx2()
+*******************************************************************************/
+__attribute__((target("avx2")))
+static void exporter_convert_24_avx2(short int* buffer, unsigned char* out, int num_samples)
+{
+  int i;
+
+  __m128i samples;
+  __m128i shuffle_lo;
+  __m128i shuffle_hi;
+
+  /* each sample becomes a zero byte followed by its two bytes; the */
+  /* eight samples fill 16 bytes, and then 8 more                   */
+  shuffle_lo = _mm_setr_epi8( -128, 0, 1, -128, 2, 3, -128, 4,
+                              5, -128, 6, 7, -128, 8, 9, -128);
+  shuffle_hi = _mm_setr_epi8( 10, 11, -128, 12, 13, -128, 14, 15,
+                              -128, -128, -128, -128, -128, -128, -128, -128);
+
+  for (i = 0; i + 8 <= num_samples; i += 8)
+  {
+    samples = _mm_loadu_si128((__m128i*) &buffer[i]);
+
+    _mm_storeu_si128((__m128i*) &out[3 * i],
+                     _mm_shuffle_epi8(samples, shuffle_lo));
+    _mm_storel_epi64((__m128i*) &out[3 * i + 16],
+                     _mm_shuffle_epi8(samples, shuffle_hi));
+  }
+
+  /* remaining samples */
+  exporter_convert_24(&buffer[i], &out[3 * i], num_samples - i);
+}
+
+/*******************************************************************************
+** exporter_convert_float_avx2()
+*******************************************************************************/
+__attribute__((target("avx2")))
+static void exporter_convert_float_avx2(short int* buffer, unsigned char* out, int num_samples)
+{
+  int i;
 
-  S_byte_rate = 0;
-  S_audio_format = 0;
-  S_block_align = 0;
+  __m256  scale;
+  __m256  val;
 
-  S_sampling_rate = 0;
-  S_bits_per_sample = 0;
-  S_num_channels = 0;
+  scale = _mm256_set1_ps(1.0f / 32768.0f);
+
+  for (i = 0; i + 8 <= num_samples; i += 8)
+  {
+    val = _mm256_cvtepi32_ps(
+            _mm256_cvtepi16_epi32(_mm_loadu_si128((__m128i*) &buffer[i])));
+
+    _mm256_storeu_ps((float*) &out[4 * i], _mm256_mul_ps(val, scale));
+  }
+
+  /* remaining samples */
+  exporter_convert_float(&buffer[i], &out[4 * i], num_samples - i);
+}
+#endif
+
+/*******************************************************************************
+** exporter_select_kernels()
+*******************************************************************************/
+short int exporter_select_kernels()
+{
+  unsigned short int  probe;
+  unsigned char       first;
+
+  /* choose the conversion kernels for this host */
+  S_exporter_convert_8 = exporter_convert_8;
+  S_exporter_convert_16 = exporter_convert_16;
+  S_exporter_convert_24 = exporter_convert_24;
+  S_exporter_convert_float = exporter_convert_float;
+
+  /* 16 bit samples are copied as is on little endian hosts */
+  probe = 1;
+  memcpy(&first, &probe, 1);
+
+  if (first == 1)
+    S_exporter_convert_16 = exporter_copy_16;
+
+#ifdef EXPORTER_X86_SIMD
+  __builtin_cpu_init();
+
+  if (__builtin_cpu_supports("avx2"))
+  {
+    S_exporter_convert_8 = exporter_convert_8_avx2;
+    S_exporter_convert_24 = exporter_convert_24_avx2;
+    S_exporter_convert_float = exporter_convert_float_avx2;
+  }
+#endif
+
+  return 0;
+}
+
+/*******************************************************************************
+** exporter_init()
+*******************************************************************************/
+short int exporter_init(exporter* e)
+{
+  if (e == NULL)
+    return 1;
+
+  e->fp = NULL;
+  e->mb = NULL;
+
+  e->staging = NULL;
+  e->staging_bytes = 0;
+
+  e->thread = NULL;
+
+  e->chunk_size = 0;
+  e->subchunk1_size = 0;
+  e->subchunk2_size = 0;
+
+  e->byte_rate = 0;
+  e->audio_format = 0;
+  e->block_align = 0;
+
+  e->sampling_rate = 0;
+  e->bits_per_sample = 0;
+  e->num_channels = 0;
+
+  e->num_samples = 0;
 
   return 0;
 }
 
 /*******************************************************************************
-** export_deinit()
+** exporter_create()
+*******************************************************************************/
+exporter* exporter_create()
+{
+  exporter* e;
+
+  e = malloc(sizeof(exporter));
+  exporter_init(e);
+
+  return e;
+}
+
+/*******************************************************************************
+** exporter_deinit()
 *******************************************************************************/
-short int export_deinit()
+short int exporter_deinit(exporter* e)
 {
+  if (e == NULL)
+    return 1;
+
   /* close open file if necessary */
-  if (S_export_fp != NULL)
-    export_close_file();
+  if (e->fp != NULL)
+    exporter_close_file(e);
+
+  if (e->staging != NULL)
+  {
+    free(e->staging);
+    e->staging = NULL;
+  }
+
+  e->staging_bytes = 0;
+
+  e->chunk_size = 0;
+  e->subchunk1_size = 0;
+  e->subchunk2_size = 0;
+
+  e->byte_rate = 0;
+  e->audio_format = 0;
+  e->block_align = 0;
+
+  e->sampling_rate = 0;
+  e->bits_per_sample = 0;
+  e->num_channels = 0;
+
+  e->num_samples = 0;
+
+  return 0;
+}
+
+/*******************************************************************************
+** exporter_destroy()
+*******************************************************************************/
+short int exporter_destroy(exporter* e)
+{
+  if (e == NULL)
+    return 1;
+
+  exporter_deinit(e);
+  free(e);
+
+  return 0;
+}
+
+/*******************************************************************************
+** exporter_open_staging()
+*******************************************************************************/
+static short int exporter_open_staging(exporter* e)
+{
+  void* staging;
 
-  S_chunk_size = 0;
-  S_subchunk1_size = 0;
-  S_subchunk2_size = 0;
+  /* allocate the staging buffer (it is kept between files) */
+  if (e->staging == NULL)
+  {
+    if (posix_memalign(&staging, 32, EXPORTER_STAGING_SIZE))
+      return 1;
+
+    e->staging = staging;
+  }
 
-  S_byte_rate = 0;
-  S_audio_format = 0;
-  S_block_align = 0;
+  e->staging_bytes = 0;
 
-  S_sampling_rate = 0;
-  S_bits_per_sample = 0;
-  S_num_channels = 0;
+  /* the header has not been written yet */
+  e->block_align = 0;
+  e->num_samples = 0;
 
   return 0;
 }
 
 /*******************************************************************************
-** export_open_file()
+** exporter_open_file()
 *******************************************************************************/
-short int export_open_file(char* filename)
+short int exporter_open_file(exporter* e, char* filename)
 {
+  if (e == NULL)
+    return 1;
+
   /* close file if one is currently open */
-  if (S_export_fp != NULL)
-    export_close_file();
+  if (e->fp != NULL)
+    exporter_close_file(e);
 
   /* open file */
-  S_export_fp = fopen(filename, "wb");
+  e->fp = fopen(filename, "wb");
 
   /* if file did not open, return error */
-  if (S_export_fp == NULL)
+  if (e->fp == NULL)
+    return 1;
+
+  if (exporter_open_staging(e))
+  {
+    fclose(e->fp);
+    e->fp = NULL;
+    return 1;
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** exporter_open_memory()
+*******************************************************************************/
+short int exporter_open_memory(exporter* e, char** buffer, size_t* size)
+{
+  if ((e == NULL) || (buffer == NULL) || (size == NULL))
     return 1;
 
+  /* close file if one is currently open */
+  if (e->fp != NULL)
+    exporter_close_file(e);
+
+  /* open a stream on a growing memory buffer; the buffer and */
+  /* its size are valid once the stream is closed, and the     */
+  /* caller frees the buffer                                   */
+  e->fp = open_memstream(buffer, size);
+
+  /* if stream did not open, return error */
+  if (e->fp == NULL)
+    return 1;
+
+  if (exporter_open_staging(e))
+  {
+    fclose(e->fp);
+    e->fp = NULL;
+    return 1;
+  }
+
+  e->mb = buffer;
+
   return 0;
 }
 
 /*******************************************************************************
-** export_close_file()
+** exporter_writer_main()
 *******************************************************************************/
-short int export_close_file()
+static void* exporter_writer_main(void* arg)
 {
-  if (S_export_fp != NULL)
+  exporter*         e;
+  exporter_thread*  t;
+
+  unsigned char*    buffer;
+  size_t            num_bytes;
+  int               error;
+
+  e = (exporter*) arg;
+  t = e->thread;
+
+  pthread_mutex_lock(&t->mutex);
+
+  while (1)
   {
-    fclose(S_export_fp);
-    S_export_fp = NULL;
+    while ((t->num_queued == 0) && (t->quit == 0))
+      pthread_cond_wait(&t->cond, &t->mutex);
+
+    /* the queue is drained before quitting */
+    if (t->num_queued == 0)
+      break;
+
+    buffer = t->buffer[t->write_index];
+    num_bytes = t->num_bytes[t->write_index];
+
+    /* write the oldest queued buffer outside of the lock */
+    pthread_mutex_unlock(&t->mutex);
+
+    error = (fwrite(buffer, 1, num_bytes, e->fp) != num_bytes);
+
+    pthread_mutex_lock(&t->mutex);
+
+    if (error)
+      t->error = 1;
+
+    t->write_index = (t->write_index + 1) % EXPORTER_NUM_BUFFERS;
+    t->num_queued -= 1;
+
+    pthread_cond_broadcast(&t->cond);
+  }
+
+  pthread_mutex_unlock(&t->mutex);
+
+  return NULL;
+}
+
+/*******************************************************************************
+** exporter_write_staging()
+*******************************************************************************/
+static short int exporter_write_staging(exporter* e)
+{
+  exporter_thread* t;
+
+  size_t  num_bytes;
+  int     error;
+
+  num_bytes = e->staging_bytes;
+
+  if (num_bytes == 0)
+    return 0;
+
+  /* without the writer thread, write out the staged samples directly */
+  if (e->thread == NULL)
+  {
+    e->staging_bytes = 0;
+
+    if (fwrite(e->staging, 1, num_bytes, e->fp) != num_bytes)
+      return 1;
+
+    return 0;
+  }
+
+  /* queue the staging buffer, and move on to the next free one */
+  t = e->thread;
+
+  pthread_mutex_lock(&t->mutex);
+
+  t->num_bytes[t->fill_index] = num_bytes;
+  t->num_queued += 1;
+
+  pthread_cond_broadcast(&t->cond);
+
+  t->fill_index = (t->fill_index + 1) % EXPORTER_NUM_BUFFERS;
+
+  while (t->num_queued == EXPORTER_NUM_BUFFERS)
+    pthread_cond_wait(&t->cond, &t->mutex);
+
+  error = t->error;
+
+  pthread_mutex_unlock(&t->mutex);
+
+  e->staging = t->buffer[t->fill_index];
+  e->staging_bytes = 0;
+
+  return error ? 1 : 0;
+}
+
+/*******************************************************************************
+** exporter_flush()
+*******************************************************************************/
+short int exporter_flush(exporter* e)
+{
+  exporter_thread* t;
+
+  int error;
+
+  if ((e == NULL) || (e->fp == NULL))
+    return 1;
+
+  if (exporter_write_staging(e))
+    return 1;
+
+  if (e->thread == NULL)
+    return 0;
+
+  /* wait until the writer thread has written all of the queued buffers */
+  t = e->thread;
+
+  pthread_mutex_lock(&t->mutex);
+
+  while (t->num_queued > 0)
+    pthread_cond_wait(&t->cond, &t->mutex);
+
+  error = t->error;
+
+  pthread_mutex_unlock(&t->mutex);
+
+  return error ? 1 : 0;
+}
+
+/*******************************************************************************
+** exporter_start_thread()
+*******************************************************************************/
+short int exporter_start_thread(exporter* e)
+{
+  int i;
+
+  exporter_thread* t;
+
+  void* buffer;
+
+  if ((e == NULL) || (e->fp == NULL) || (e->staging == NULL))
+    return 1;
+
+  if (e->thread != NULL)
+    return 0;
+
+  t = malloc(sizeof(exporter_thread));
+
+  if (t == NULL)
+    return 1;
+
+  /* the current staging buffer is the first buffer in the queue */
+  t->buffer[0] = e->staging;
+  t->num_bytes[0] = 0;
+
+  for (i = 1; i < EXPORTER_NUM_BUFFERS; i++)
+  {
+    if (posix_memalign(&buffer, 32, EXPORTER_STAGING_SIZE))
+      break;
+
+    t->buffer[i] = buffer;
+    t->num_bytes[i] = 0;
+  }
+
+  if (i < EXPORTER_NUM_BUFFERS)
+  {
+    while (--i > 0)
+      free(t->buffer[i]);
+
+    free(t);
+    return 1;
+  }
+
+  t->fill_index = 0;
+  t->write_index = 0;
+  t->num_queued = 0;
+
+  t->error = 0;
+  t->quit = 0;
+
+  pthread_mutex_init(&t->mutex, NULL);
+  pthread_cond_init(&t->cond, NULL);
+
+  e->thread = t;
+
+  /* start writer; if it did not start, write on the calling thread only */
+  if (pthread_create(&t->thread, NULL, exporter_writer_main, e))
+  {
+    e->thread = NULL;
+
+    pthread_cond_destroy(&t->cond);
+    pthread_mutex_destroy(&t->mutex);
+
+    for (i = 1; i < EXPORTER_NUM_BUFFERS; i++)
+      free(t->buffer[i]);
+
+    free(t);
+    return 1;
   }
 
   return 0;
 }
 
 /*******************************************************************************
-** export_write_header()
+** exporter_stop_thread()
+*******************************************************************************/
+short int exporter_stop_thread(exporter* e)
+{
+  int i;
+
+  exporter_thread* t;
+
+  short int result;
+
+  if (e == NULL)
+    return 1;
+
+  if (e->thread == NULL)
+    return 0;
+
+  t = e->thread;
+
+  /* write out the remaining samples, then release the writer */
+  result = exporter_flush(e);
+
+  pthread_mutex_lock(&t->mutex);
+  t->quit = 1;
+  pthread_cond_broadcast(&t->cond);
+  pthread_mutex_unlock(&t->mutex);
+
+  pthread_join(t->thread, NULL);
+
+  pthread_cond_destroy(&t->cond);
+  pthread_mutex_destroy(&t->mutex);
+
+  /* the current staging buffer is kept, and the others are freed */
+  for (i = 0; i < EXPORTER_NUM_BUFFERS; i++)
+  {
+    if (t->buffer[i] != e->staging)
+      free(t->buffer[i]);
+  }
+
+  free(t);
+  e->thread = NULL;
+
+  return result;
+}
+
+/*******************************************************************************
+** exporter_close_file()
+*******************************************************************************/
+short int exporter_close_file(exporter* e)
+{
+  unsigned char field[4];
+
+  short int result;
+
+  if (e == NULL)
+    return 1;
+
+  result = 0;
+
+  if (e->fp != NULL)
+  {
+    /* the writer thread is stopped before the header is patched; */
+    /* a write that failed on either thread fails the close        */
+    if (exporter_stop_thread(e))
+      result = 1;
+
+    if (exporter_flush(e))
+      result = 1;
+
+    /* patch the chunk sizes in the header */
+    if (e->block_align != 0)
+    {
+      e->subchunk2_size = e->num_samples * e->block_align;
+      e->chunk_size = 4 + (8 + e->subchunk1_size) + (8 + e->subchunk2_size);
+
+      /* a memory stream is truncated when seeking back, */
+      /* so its header is patched in the buffer directly  */
+      if (e->mb != NULL)
+      {
+        if (fflush(e->fp))
+          result = 1;
+        else
+        {
+          exporter_put_u32((unsigned char*) &(*e->mb)[4], e->chunk_size);
+          exporter_put_u32((unsigned char*) &(*e->mb)[40], e->subchunk2_size);
+        }
+      }
+      else
+      {
+        exporter_put_u32(field, e->chunk_size);
+
+        if (fseek(e->fp, 4, SEEK_SET) || (fwrite(field, 1, 4, e->fp) != 4))
+          result = 1;
+
+        exporter_put_u32(field, e->subchunk2_size);
+
+        if (fseek(e->fp, 40, SEEK_SET) || (fwrite(field, 1, 4, e->fp) != 4))
+          result = 1;
+      }
+    }
+
+    /* the last of the buffered data is written when the file is closed */
+    if (fclose(e->fp))
+      result = 1;
+
+    e->fp = NULL;
+    e->mb = NULL;
+  }
+
+  return result;
+}
+
+/*******************************************************************************
+** exporter_write_header()
 *******************************************************************************/
-short int export_write_header(int num_samples)
+short int exporter_write_header(exporter* e, int sampling_rate, int bits_per_sample)
 {
-  char id_field[4];
+  unsigned char header[EXPORTER_HEADER_SIZE];
 
   /* make sure that file pointer is present */
-  if (S_export_fp == NULL)
+  if ((e == NULL) || (e->fp == NULL))
     return 1;
 
-  /* make sure number of samples is positive */
-  if (num_samples <= 0)
+  /* make sure bits per sample is valid (32 bit samples are float) */
+  if ( (bits_per_sample != 8)   && (bits_per_sample != 16) &&
+       (bits_per_sample != 24)  && (bits_per_sample != 32))
+  {
     return 1;
+  }
 
   /* set sampling rate and bits per sample */
-  S_sampling_rate = G_export_sampling;
-  S_bits_per_sample = G_export_bitres;
+  e->sampling_rate = sampling_rate;
+  e->bits_per_sample = bits_per_sample;
 
   /* set number of channels (mono) */
-  S_num_channels = 1;
+  e->num_channels = 1;
 
   /* compute subchunk sizes and other derived field values */
-  S_audio_format = 1; /* 1 denotes PCM */
-  S_block_align = S_num_channels * (S_bits_per_sample / 8);
-  S_byte_rate = S_sampling_rate * S_block_align;
-
-  S_subchunk1_size = 16; /* always 16 for PCM data */
-  S_subchunk2_size = num_samples * S_block_align;
-  S_chunk_size = 4 + (8 + S_subchunk1_size) + (8 + S_subchunk2_size);
-
-  /* write 'RIFF' chunk */
-  id_field[0] = 'R';
-  id_field[1] = 'I';
-  id_field[2] = 'F';
-  id_field[3] = 'F';
-  fwrite(id_field, 1, 4, S_export_fp);
-
-  fwrite(&S_chunk_size, 4, 1, S_export_fp);
-
-  id_field[0] = 'W';
-  id_field[1] = 'A';
-  id_field[2] = 'V';
-  id_field[3] = 'E';
-  fwrite(id_field, 1, 4, S_export_fp);
-
-  /* write 'fmt ' chunk */
-  id_field[0] = 'f';
-  id_field[1] = 'm';
-  id_field[2] = 't';
-  id_field[3] = ' ';
-  fwrite(id_field, 1, 4, S_export_fp);
-
-  fwrite(&S_subchunk1_size, 4, 1, S_export_fp);
-  fwrite(&S_audio_format, 2, 1, S_export_fp);
-  fwrite(&S_num_channels, 2, 1, S_export_fp);
-  fwrite(&S_sampling_rate, 4, 1, S_export_fp);
-  fwrite(&S_byte_rate, 4, 1, S_export_fp);
-  fwrite(&S_block_align, 2, 1, S_export_fp);
-  fwrite(&S_bits_per_sample, 2, 1, S_export_fp);
-
-  /* write 'data' chunk */
-  id_field[0] = 'd';
-  id_field[1] = 'a';
-  id_field[2] = 't';
-  id_field[3] = 'a';
-  fwrite(id_field, 1, 4, S_export_fp);
-
-  fwrite(&S_subchunk2_size, 4, 1, S_export_fp);
+  if (e->bits_per_sample == 32)
+    e->audio_format = 3; /* 3 denotes IEEE float */
+  else
+    e->audio_format = 1; /* 1 denotes PCM */
+
+  e->block_align = e->num_channels * (e->bits_per_sample / 8);
+  e->byte_rate = e->sampling_rate * e->block_align;
+
+  /* the data size is not known until the file is closed, */
+  /* so the sizes are patched in exporter_close_file()      */
+  e->num_samples = 0;
+
+  e->subchunk1_size = 16; /* always 16 for PCM data */
+  e->subchunk2_size = 0;
+  e->chunk_size = 4 + (8 + e->subchunk1_size) + (8 + e->subchunk2_size);
+
+  /* 'RIFF' chunk */
+  memcpy(&header[0], "RIFF", 4);
+  exporter_put_u32(&header[4], e->chunk_size);
+  memcpy(&header[8], "WAVE", 4);
+
+  /* 'fmt ' chunk */
+  memcpy(&header[12], "fmt ", 4);
+  exporter_put_u32(&header[16], e->subchunk1_size);
+  exporter_put_u16(&header[20], e->audio_format);
+  exporter_put_u16(&header[22], e->num_channels);
+  exporter_put_u32(&header[24], e->sampling_rate);
+  exporter_put_u32(&header[28], e->byte_rate);
+  exporter_put_u16(&header[32], e->block_align);
+  exporter_put_u16(&header[34], e->bits_per_sample);
+
+  /* 'data' chunk */
+  memcpy(&header[36], "data", 4);
+  exporter_put_u32(&header[40], e->subchunk2_size);
+
+  /* the header goes ahead of any staged samples */
+  if (exporter_flush(e))
+    return 1;
+
+  if (fwrite(header, 1, EXPORTER_HEADER_SIZE, e->fp) != EXPORTER_HEADER_SIZE)
+    return 1;
 
   return 0;
 }
 
 /*******************************************************************************
-** export_write_block()
+** exporter_write_block()
 *******************************************************************************/
-short int export_write_block(short int* buffer, int num_samples)
+short int exporter_write_block(exporter* e, short int* buffer, int num_samples)
 {
-  int           i;
-  unsigned char temp_char;
+  int i;
+  int n;
+
+  unsigned char* out;
 
   /* make sure that file pointer is present */
-  if (S_export_fp == NULL)
+  if ((e == NULL) || (e->fp == NULL) || (e->staging == NULL))
     return 1;
 
   /* make sure number of samples is positive */
   if (num_samples <= 0)
     return 1;
 
-  /* make sure position is the end of the file */
-  fseek(S_export_fp, 0, SEEK_END);
+  /* make sure the header has been written */
+  if (e->block_align == 0)
+    return 1;
 
-  /* write 8-bit mono data */
-  if (G_export_bitres == 8)
+  /* convert the samples into the staging buffer, writing it out when full */
+  for (i = 0; i < num_samples; i += n)
   {
-    for (i = 0; i < num_samples; i++)
+    n = (EXPORTER_STAGING_SIZE - e->staging_bytes) / e->block_align;
+
+    if (n == 0)
     {
-      temp_char = 127 - (buffer[i] / 256);
-      fwrite(&temp_char, 1, 1, S_export_fp);
+      if (exporter_write_staging(e))
+        return 1;
+
+      continue;
     }
+
+    if (n > num_samples - i)
+      n = num_samples - i;
+
+    out = &e->staging[e->staging_bytes];
+
+    if (e->bits_per_sample == 8)
+      S_exporter_convert_8(&buffer[i], out, n);
+    else if (e->bits_per_sample == 16)
+      S_exporter_convert_16(&buffer[i], out, n);
+    else if (e->bits_per_sample == 24)
+      S_exporter_convert_24(&buffer[i], out, n);
+    else
+      S_exporter_convert_float(&buffer[i], out, n);
+
+    e->staging_bytes += n * e->block_align;
   }
-  /* write 16-bit mono data */
-  else if (G_export_bitres == 16)
-  {
-    fwrite(buffer, 2, num_samples, S_export_fp);
-  }
-  /* otherwise, return error */
-  else
-    return 1;
+
+  e->num_samples += num_samples;
 
   return 0;
 }
-
@@ -5,14 +5,61 @@
 #ifndef EXPORT_H
 #define EXPORT_H
 
+#include <stdio.h>
+
+#define EXPORTER_HEADER_SIZE  44
+#define EXPORTER_STAGING_SIZE 65536
+#define EXPORTER_NUM_BUFFERS  3
+
+/* writer thread (defined in export.c) */
+struct exporter_thread;
+
+typedef struct exporter
+{
+  FILE*           fp;
+  char**          mb;               /* memory buffer (when writing to memory) */
+
+  /* converted samples waiting to be written */
+  unsigned char*  staging;
+  int             staging_bytes;
+
+  /* writer thread (null when writing on the calling thread only) */
+  struct exporter_thread* thread;
+
+  /* wav header fields */
+  unsigned int    chunk_size;
+  unsigned int    subchunk1_size;
+  unsigned int    subchunk2_size;
+
+  unsigned int    byte_rate;
+  unsigned short  audio_format;
+  unsigned short  block_align;
+
+  unsigned int    sampling_rate;
+  unsigned short  bits_per_sample;
+  unsigned short  num_channels;
+
+  /* number of samples written */
+  int             num_samples;
+} exporter;
+
 /* function declarations */
-short int export_init();
-short int export_deinit();
+short int exporter_init(exporter* e);
+exporter* exporter_create();
+short int exporter_deinit(exporter* e);
+short int exporter_destroy(exporter* e);
+
+short int exporter_open_file(exporter* e, char* filename);
+short int exporter_open_memory(exporter* e, char** buffer, size_t* size);
+short int exporter_close_file(exporter* e);
+short int exporter_flush(exporter* e);
+
+short int exporter_start_thread(exporter* e);
+short int exporter_stop_thread(exporter* e);
 
-short int export_open_file(char* filename);
-short int export_close_file();
+short int exporter_select_kernels();
 
-short int export_write_header(int num_samples);
-short int export_write_block(short int* buffer, int num_samples);
+short int exporter_write_header(exporter* e, int sampling_rate, int bits_per_sample);
+short int exporter_write_block(exporter* e, short int* buffer, int num_samples);
 
 #endif
@@ -11,6 +11,18 @@
 #include "shaping.h"
 #include "tuning.h"
 
+/* the filters run in fixed point unless built with FILTER_FLOAT defined. */
+/* the coefficients have TUNING_FILTER_FIXED_BITS fraction bits and are   */
+/* below 2, so x is split into its high and low parts to keep both        */
+/* products within 32 bits. the result is x * g rounded to nearest.       */
+#define FILTER_FIXED_ONE  (1 << TUNING_FILTER_FIXED_BITS)
+#define FILTER_FIXED_HALF (1 << (TUNING_FILTER_FIXED_BITS - 1))
+
+#define FILTER_FIXED_MULTIPLY(x, g)                                           \
+  ((((x) >> TUNING_FILTER_FIXED_BITS) * (g)) +                                \
+  (((((x) & (FILTER_FIXED_ONE - 1)) * (g)) + FILTER_FIXED_HALF) >>            \
+    TUNING_FILTER_FIXED_BITS))
+
 /*******************************************************************************
 ** filter_init()
 *******************************************************************************/
@@ -21,9 +33,17 @@ short int filter_init(filter* fltr)
   if (fltr == NULL)
     return 1;
 
+  fltr->tuning = NULL;
+
   fltr->fc_index = 0;
   fltr->res_index = 0;
 
+  fltr->coefficient_fc_index = -1;
+  fltr->k = 0;
+  fltr->stage_multiplier = 0;
+
+  fltr->control_period = FILTER_DEFAULT_CONTROL_PERIOD;
+
   for (i = 0; i < 2; i++)
   {
     fltr->s[i] = 0;
@@ -57,6 +77,8 @@ short int filter_deinit(filter* fltr)
   if (fltr == NULL)
     return 1;
 
+  fltr->tuning = NULL;
+
   return 0;
 }
 
@@ -98,6 +120,32 @@ short int filter_set_indices(filter* fltr, int fc_index, int res_index)
   else
     fltr->res_index = res_index;
 
+  /* obtain resonance multiplier; the stage multiplier */
+  /* is read from the tuning tables when it is next used */
+#ifdef FILTER_FLOAT
+  fltr->k = G_resonance_table[fltr->res_index];
+#else
+  fltr->k = G_resonance_fixed_table[fltr->res_index];
+#endif
+
+  fltr->coefficient_fc_index = -1;
+
+  return 0;
+}
+
+/*******************************************************************************
+** filter_set_control_period()
+*******************************************************************************/
+short int filter_set_control_period(filter* fltr, int control_period)
+{
+  if (fltr == NULL)
+    return 1;
+
+  if ((control_period < 1) || (control_period > FILTER_MAX_CONTROL_PERIOD))
+    return 1;
+
+  fltr->control_period = control_period;
+
   return 0;
 }
 
@@ -118,81 +166,269 @@ short int filter_reset(filter* fltr)
     fltr->y[i] = 0;
   }
 
+  fltr->coefficient_fc_index = -1;
+
   fltr->level = 0;
 
   return 0;
 }
 
 /*******************************************************************************
-** filter_update_highpass()
+** filter_is_at_rest()
 *******************************************************************************/
-short int filter_update_highpass(filter* fltr, int input)
+short int filter_is_at_rest(filter* fltr)
 {
-  float stage_multiplier;
-
   if (fltr == NULL)
+    return 0;
+
+  /* with no input, a filter whose state is zero stays at zero */
+  if ((fltr->s[0] == 0) && (fltr->s[1] == 0) && 
+      (fltr->y[0] == 0) && (fltr->y[1] == 0))
+  {
     return 1;
+  }
 
-  /* obtain multipliers from tables */
-  stage_multiplier = 
-    G_filter_stage_multiplier_table[fltr->fc_index];
+  return 0;
+}
+
+/*******************************************************************************
+** filter_process_highpass_block()
+*******************************************************************************/
+short int filter_process_highpass_block(filter* fltr, 
+                                        int* buffer, int num_samples)
+{
+  int   i;
+
+  filter_coefficient stage_multiplier;
+
+  int   input;
+
+  int   s0;
+  int   s1;
+  int   y0;
+  int   y1;
+  int   v0;
+  int   v1;
+
+  if ((fltr == NULL) || (fltr->tuning == NULL))
+    return 1;
+
+  if (num_samples <= 0)
+    return 0;
+
+  /* obtain multiplier (the cutoff is fixed, so it is cached) */
+  if (fltr->coefficient_fc_index != fltr->fc_index)
+  {
+#ifdef FILTER_FLOAT
+    fltr->stage_multiplier = 
+      fltr->tuning->filter_stage_multiplier_table[fltr->fc_index];
+#else
+    fltr->stage_multiplier = 
+      fltr->tuning->filter_stage_multiplier_fixed_table[fltr->fc_index];
+#endif
+
+    fltr->coefficient_fc_index = fltr->fc_index;
+  }
+
+  stage_multiplier = fltr->stage_multiplier;
+
+  /* load filter state */
+  s0 = fltr->s[0];
+  s1 = fltr->s[1];
 
   /* see Vadim Zavalishin's "The Art of VA Filter Design" (p. 77) */
+  for (i = 0; i < num_samples; i++)
+  {
+    input = buffer[i];
+
+#ifdef FILTER_FLOAT
+    /* integrator 1 */
+    v0 = (int) (((input - s0) * stage_multiplier) + 0.5f);
+    y0 = v0 + s0;
+    s0 = y0 + v0;
+
+    /* integrator 2 */
+    v1 = (int) ((((input - y0) - s1) * stage_multiplier) + 0.5f);
+    y1 = v1 + s1;
+    s1 = y1 + v1;
+#else
+    /* integrator 1 */
+    v0 = input - s0;
+    v0 = FILTER_FIXED_MULTIPLY(v0, stage_multiplier);
+    y0 = v0 + s0;
+    s0 = y0 + v0;
+
+    /* integrator 2 */
+    v1 = (input - y0) - s1;
+    v1 = FILTER_FIXED_MULTIPLY(v1, stage_multiplier);
+    y1 = v1 + s1;
+    s1 = y1 + v1;
+#endif
 
-  /* integrator 1 */
-  fltr->v[0] = (int) (((input - fltr->s[0]) * stage_multiplier) + 0.5f);
-  fltr->y[0] = fltr->v[0] + fltr->s[0];
-  fltr->s[0] = fltr->y[0] + fltr->v[0];
+    /* set output level */
+    buffer[i] = input - y0 - y1;
+  }
 
-  /* integrator 2 */
-  fltr->v[1] = (int) ((((input - fltr->y[0]) - fltr->s[1]) * stage_multiplier) + 0.5f);
-  fltr->y[1] = fltr->v[1] + fltr->s[1];
-  fltr->s[1] = fltr->y[1] + fltr->v[1];
+  /* store filter state */
+  fltr->s[0] = s0;
+  fltr->s[1] = s1;
 
-  /* set output level */
-  fltr->level = input - fltr->y[0] - fltr->y[1];
+  fltr->v[0] = v0;
+  fltr->v[1] = v1;
+
+  fltr->y[0] = y0;
+  fltr->y[1] = y1;
+
+  fltr->level = buffer[num_samples - 1];
 
   return 0;
 }
 
 /*******************************************************************************
-** filter_update_lowpass()
+** filter_process_lowpass_block()
 *******************************************************************************/
-short int filter_update_lowpass(filter* fltr, int input)
+short int filter_process_lowpass_block( filter* fltr, 
+                                        int* buffer, int* fc_indices, 
+                                        int num_samples)
 {
-  float k;
-  float g;
-  float stage_multiplier;
+  int   i;
+  int   j;
+  int   end;
+
+  filter_coefficient  k;
+  filter_coefficient  stage_multiplier;
+  filter_coefficient  target;
+  filter_coefficient  step;
+
+#ifdef FILTER_FLOAT
+  float*  stage_multiplier_table;
+#else
+  int*    stage_multiplier_table;
+#endif
 
   int   u;
 
-  if (fltr == NULL)
+  int   s0;
+  int   s1;
+  int   y0;
+  int   y1;
+  int   v0;
+  int   v1;
+
+  if ((fltr == NULL) || (fltr->tuning == NULL))
     return 1;
 
-  /* obtain multipliers from tables */
-  k = G_resonance_table[fltr->res_index];
+  if (num_samples <= 0)
+    return 0;
 
-  g = G_filter_omega_0_delta_t_over_2_table[fltr->fc_index];
-  stage_multiplier = G_filter_stage_multiplier_table[fltr->fc_index];
+  /* the resonance is fixed over the block */
+  k = fltr->k;
 
-  /* resonant filter: tranposed sallen-key filter                           */
-  /* Vadim Zavalishin's "The Art of VA Filter Design", Figure 5.23, p. 152  */
+#ifdef FILTER_FLOAT
+  stage_multiplier_table = fltr->tuning->filter_stage_multiplier_table;
+#else
+  stage_multiplier_table = fltr->tuning->filter_stage_multiplier_fixed_table;
+#endif
 
-  /* compute input to first integrator */
-  u = input + (int) ((k * (fltr->y[0] - fltr->y[1])) + 0.5f);
+  /* without cached coefficients, start at the first cutoff */
+  if (fltr->coefficient_fc_index == -1)
+  {
+    fltr->stage_multiplier = stage_multiplier_table[fc_indices[0]];
+    fltr->coefficient_fc_index = fc_indices[0];
+  }
 
-  /* integrator 1 */
-  fltr->v[0] = (int) (((u - fltr->s[0]) * stage_multiplier) + 0.5f);
-  fltr->y[0] = fltr->v[0] + fltr->s[0];
-  fltr->s[0] = fltr->y[0] + fltr->v[0];
+  stage_multiplier = fltr->stage_multiplier;
 
-  /* integrator 2 */
-  fltr->v[1] = (int) (((fltr->y[0] - fltr->s[1]) * stage_multiplier) + 0.5f);
-  fltr->y[1] = fltr->v[1] + fltr->s[1];
-  fltr->s[1] = fltr->y[1] + fltr->v[1];
+  /* load filter state */
+  s0 = fltr->s[0];
+  s1 = fltr->s[1];
+  y0 = fltr->y[0];
+  y1 = fltr->y[1];
+  v0 = fltr->v[0];
+  v1 = fltr->v[1];
 
-  /* set output level */
-  fltr->level = fltr->y[1];
+  /* there is one cutoff index for each control period, which is reached */
+  /* at its last sample; the stage multiplier is interpolated towards it */
+  for (i = 0, j = 0; i < num_samples; j++)
+  {
+    end = i + fltr->control_period;
+
+    if (end > num_samples)
+      end = num_samples;
+
+    /* the tables are only read when the cutoff changes */
+    if (fc_indices[j] == fltr->coefficient_fc_index)
+    {
+      target = stage_multiplier;
+      step = 0;
+    }
+    else
+    {
+      target = stage_multiplier_table[fc_indices[j]];
+      step = (target - stage_multiplier) / (end - i);
+
+      fltr->coefficient_fc_index = fc_indices[j];
+    }
+
+    /* resonant filter: tranposed sallen-key filter                           */
+    /* Vadim Zavalishin's "The Art of VA Filter Design", Figure 5.23, p. 152  */
+    for (; i < end; i++)
+    {
+      stage_multiplier += step;
+
+#ifdef FILTER_FLOAT
+      /* compute input to first integrator */
+      u = buffer[i] + (int) ((k * (y0 - y1)) + 0.5f);
+
+      /* integrator 1 */
+      v0 = (int) (((u - s0) * stage_multiplier) + 0.5f);
+      y0 = v0 + s0;
+      s0 = y0 + v0;
+
+      /* integrator 2 */
+      v1 = (int) (((y0 - s1) * stage_multiplier) + 0.5f);
+      y1 = v1 + s1;
+      s1 = y1 + v1;
+#else
+      /* compute input to first integrator */
+      u = y0 - y1;
+      u = buffer[i] + FILTER_FIXED_MULTIPLY(u, k);
+
+      /* integrator 1 */
+      v0 = u - s0;
+      v0 = FILTER_FIXED_MULTIPLY(v0, stage_multiplier);
+      y0 = v0 + s0;
+      s0 = y0 + v0;
+
+      /* integrator 2 */
+      v1 = y0 - s1;
+      v1 = FILTER_FIXED_MULTIPLY(v1, stage_multiplier);
+      y1 = v1 + s1;
+      s1 = y1 + v1;
+#endif
+
+      /* set output level */
+      buffer[i] = y1;
+    }
+
+    /* land exactly on the target (the steps are rounded) */
+    stage_multiplier = target;
+  }
+
+  /* store filter state */
+  fltr->fc_index = fltr->coefficient_fc_index;
+  fltr->stage_multiplier = stage_multiplier;
+
+  fltr->s[0] = s0;
+  fltr->s[1] = s1;
+
+  fltr->v[0] = v0;
+  fltr->v[1] = v1;
+
+  fltr->y[0] = y0;
+  fltr->y[1] = y1;
+
+  fltr->level = y1;
 
   return 0;
 }
@@ -224,8 +460,8 @@ short int filter_update_lowpass_with_saturator(filter* fltr, int input)
   /* obtain multipliers from tables */
   k = G_resonance_table[fltr->res_index];
 
-  g = G_filter_omega_0_delta_t_over_2_table[fltr->fc_index];
-  stage_multiplier = G_filter_stage_multiplier_table[fltr->fc_index];
+  g = fltr->tuning->filter_omega_0_delta_t_over_2_table[fltr->fc_index];
+  stage_multiplier = fltr->tuning->filter_stage_multiplier_table[fltr->fc_index];
 
   /* resonant filter: tranposed sallen-key filter                           */
   /* Vadim Zavalishin's "The Art of VA Filter Design", Figure 5.23, p. 152  */
@@ -5,11 +5,35 @@
 #ifndef FILTER_H
 #define FILTER_H
 
+#include "tuning.h"
+
+/* the lowpass cutoff is modulated at the control rate; the   */
+/* coefficients are interpolated over each control period     */
+#define FILTER_DEFAULT_CONTROL_PERIOD 16
+#define FILTER_MAX_CONTROL_PERIOD     256
+
+#ifdef FILTER_FLOAT
+typedef float filter_coefficient;
+#else
+typedef int   filter_coefficient;
+#endif
+
 typedef struct filter
 {
+  /* coefficient tables */
+  tuning_tables*  tuning;
+
   int   fc_index;
   int   res_index;
 
+  /* cached coefficients (coefficient_fc_index is -1 if none are cached) */
+  int                 coefficient_fc_index;
+  filter_coefficient  k;
+  filter_coefficient  stage_multiplier;
+
+  /* samples per cutoff update */
+  int   control_period;
+
   int   s[2];
   int   v[2];
   int   y[2];
@@ -24,9 +48,14 @@ short int filter_deinit(filter* fltr);
 short int filter_destroy(filter* fltr);
 
 short int filter_set_indices(filter* fltr, int fc_index, int res_index);
+short int filter_set_control_period(filter* fltr, int control_period);
 
 short int filter_reset(filter* fltr);
-short int filter_update_highpass(filter* fltr, int input);
-short int filter_update_lowpass(filter* fltr, int input);
+short int filter_is_at_rest(filter* fltr);
+short int filter_process_highpass_block(filter* fltr, 
+                                        int* buffer, int num_samples);
+short int filter_process_lowpass_block( filter* fltr, 
+                                        int* buffer, int* fc_indices, 
+                                        int num_samples);
 
 #endif
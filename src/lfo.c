@@ -9,14 +9,17 @@
 #include "clock.h"
 #include "global.h"
 #include "lfo.h"
+#include "waveform.h"
 
 /* vibrato / tremolo / wobble tables  */
 /* types: 4 (sine, square, saw, tri)  */
 /* rows: 16 depths                    */
 /* index: 128 steps in the wave       */
-static short int  S_vib_table[4][16][128];
-static short int  S_trem_table[4][16][128];
-static short int  S_wob_table[4][16][128];
+/* (generated by tabgen)             */
+#include "lfo_tables.h"
+
+/* table row for unknown types & waveforms */
+static const short int S_lfo_zero_row[128] = {0};
 
 /* lfo period table                               */
 /* the frequency is f = 53267/(128 * period)      */
@@ -62,7 +65,11 @@ short int lfo_init(lfo* l)
   l->index    = 0;
   l->depth    = 0;
 
-  l->lfsr     = 0x0001;
+  l->row      = S_lfo_zero_row;
+  l->reverse  = 0;
+  l->flat     = 1;
+
+  l->noise_index = 0;
 
   l->level    = 0;
 
@@ -107,6 +114,91 @@ short int lfo_destroy(lfo* l)
   return 0;
 }
 
+/*******************************************************************************
+** lfo_resolve_row()
+*******************************************************************************/
+static void lfo_resolve_row(lfo* l)
+{
+  int i;
+  int shape;
+
+  const short int (*table)[16][128];
+
+  /* determine table for the type */
+  if (l->type == LFO_TYPE_VIBRATO)
+    table = S_vib_table;
+  else if (l->type == LFO_TYPE_TREMOLO)
+    table = S_trem_table;
+  else if (l->type == LFO_TYPE_WOBBLE)
+    table = S_wob_table;
+  else
+    table = NULL;
+
+  /* determine wave shape (the noise waveform indexes the square wave) */
+  l->reverse = 0;
+
+  if (l->waveform == LFO_WAVEFORM_SINE)
+    shape = 0;
+  else if (l->waveform == LFO_WAVEFORM_SQUARE)
+    shape = 1;
+  else if (l->waveform == LFO_WAVEFORM_TRIANGLE)
+    shape = 3;
+  else if (l->waveform == LFO_WAVEFORM_SAW_UP)
+    shape = 2;
+  else if (l->waveform == LFO_WAVEFORM_SAW_DOWN)
+  {
+    shape = 2;
+    l->reverse = 1;
+  }
+  else if (l->waveform == LFO_WAVEFORM_NOISE)
+    shape = 1;
+  else
+    shape = -1;
+
+  if ((table == NULL) || (shape == -1))
+    l->row = S_lfo_zero_row;
+  else
+    l->row = table[shape][l->depth];
+
+  /* a row of zeros keeps the level at 0 */
+  l->flat = 1;
+
+  for (i = 0; i < 128; i++)
+  {
+    if (l->row[i] != 0)
+    {
+      l->flat = 0;
+      break;
+    }
+  }
+}
+
+/*******************************************************************************
+** lfo_lookup()
+*******************************************************************************/
+static short int lfo_lookup(lfo* l)
+{
+  if (l->reverse)
+    return l->row[127 - l->index];
+  else
+    return l->row[l->index];
+}
+
+/*******************************************************************************
+** lfo_step_noise()
+*******************************************************************************/
+static void lfo_step_noise(lfo* l, int num_steps)
+{
+  /* move through the 15-bit lfsr sequence (nes) */
+  l->noise_index = (l->noise_index + num_steps) % WAVEFORM_NOISE_PERIOD;
+
+  /* determine index in square wave table */
+  if (G_noise_table[l->noise_index])
+    l->index = 64;
+  else
+    l->index = 0;
+}
+
 /*******************************************************************************
 ** lfo_setup()
 *******************************************************************************/
@@ -118,7 +210,7 @@ short int lfo_setup(lfo* l, int waveform,
   if (l == NULL)
     return 1;
 
-  l->lfsr = 0x0001;
+  l->noise_index = 0;
 
   /* set waveform */
   l->waveform = waveform;
@@ -141,6 +233,9 @@ short int lfo_setup(lfo* l, int waveform,
   else
     l->padding = 0;
 
+  /* resolve table row */
+  lfo_resolve_row(l);
+
   return 0;
 }
 
@@ -167,19 +262,7 @@ short int lfo_update(lfo* l)
   {
     /* noise waveform: use lfsr to determine table index */
     if (l->waveform == LFO_WAVEFORM_NOISE)
-    {
-      /* 15-bit lfsr, taps on 1 and 2 (nes) */
-      if ((l->lfsr & 0x0001) ^ ((l->lfsr & 0x0002) >> 1))
-        l->lfsr = ((l->lfsr >> 1) & 0x3FFF) | 0x4000;
-      else
-        l->lfsr = (l->lfsr >> 1) & 0x3FFF;
-
-      /* determine index in square wave table */
-      if (l->lfsr & 0x0001)
-        l->index = 64;
-      else
-        l->index = 0;
-    }
+      lfo_step_noise(l, 1);
     /* other waveforms: increment table index */
     else
       l->index = (l->index + 1) % 128;
@@ -188,357 +271,119 @@ short int lfo_update(lfo* l)
   }
 
   /* update level */
-  if (l->type == LFO_TYPE_VIBRATO)
-  {
-    if (l->waveform == LFO_WAVEFORM_SINE)
-      l->level = S_vib_table[0][l->depth][l->index];
-    else if (l->waveform == LFO_WAVEFORM_SQUARE)
-      l->level = S_vib_table[1][l->depth][l->index];
-    else if (l->waveform == LFO_WAVEFORM_TRIANGLE)
-      l->level = S_vib_table[3][l->depth][l->index];
-    else if (l->waveform == LFO_WAVEFORM_SAW_UP)
-      l->level = S_vib_table[2][l->depth][l->index];
-    else if (l->waveform == LFO_WAVEFORM_SAW_DOWN)
-      l->level = S_vib_table[2][l->depth][127 - l->index];
-    else if (l->waveform == LFO_WAVEFORM_NOISE)
-      l->level = S_vib_table[1][l->depth][l->index];
-    else
-      l->level = 0;
-  }
-  else if (l->type == LFO_TYPE_TREMOLO)
-  {
-    if (l->waveform == LFO_WAVEFORM_SINE)
-      l->level = S_trem_table[0][l->depth][l->index];
-    else if (l->waveform == LFO_WAVEFORM_SQUARE)
-      l->level = S_trem_table[1][l->depth][l->index];
-    else if (l->waveform == LFO_WAVEFORM_TRIANGLE)
-      l->level = S_trem_table[3][l->depth][l->index];
-    else if (l->waveform == LFO_WAVEFORM_SAW_UP)
-      l->level = S_trem_table[2][l->depth][l->index];
-    else if (l->waveform == LFO_WAVEFORM_SAW_DOWN)
-      l->level = S_trem_table[2][l->depth][127 - l->index];
-    else if (l->waveform == LFO_WAVEFORM_NOISE)
-      l->level = S_trem_table[1][l->depth][l->index];
-    else
-      l->level = 0;
-  }
-  else if (l->type == LFO_TYPE_WOBBLE)
-  {
-    if (l->waveform == LFO_WAVEFORM_SINE)
-      l->level = S_wob_table[0][l->depth][l->index];
-    else if (l->waveform == LFO_WAVEFORM_SQUARE)
-      l->level = S_wob_table[1][l->depth][l->index];
-    else if (l->waveform == LFO_WAVEFORM_TRIANGLE)
-      l->level = S_wob_table[3][l->depth][l->index];
-    else if (l->waveform == LFO_WAVEFORM_SAW_UP)
-      l->level = S_wob_table[2][l->depth][l->index];
-    else if (l->waveform == LFO_WAVEFORM_SAW_DOWN)
-      l->level = S_wob_table[2][l->depth][127 - l->index];
-    else if (l->waveform == LFO_WAVEFORM_NOISE)
-      l->level = S_wob_table[1][l->depth][l->index];
-    else
-      l->level = 0;
-  }
+  l->level = lfo_lookup(l);
 
   return 0;
 }
 
 /*******************************************************************************
-** lfo_generate_tables()
+** lfo_samples_until_change()
 *******************************************************************************/
-short int lfo_generate_tables()
+int lfo_samples_until_change(lfo* l, int max_samples)
 {
-  int i;
-  int k;
-
-  /* vibrato tables */
-
-  /* depth  0: amplitude is   0 */
-  /* depth  1: amplitude is   2 */
-  /* depth  2: amplitude is   4 */
-  /* depth  3: amplitude is   6 */
-  /* depth  4: amplitude is   8 */
-  /* depth  5: amplitude is  10 */
-  /* depth  6: amplitude is  12 */
-  /* depth  7: amplitude is  16 */
-  /* depth  8: amplitude is  20 */
-  /* depth  9: amplitude is  24 */
-  /* depth 10: amplitude is  28 */
-  /* depth 11: amplitude is  32 */
-  /* depth 12: amplitude is  40 */
-  /* depth 13: amplitude is  48 */
-  /* depth 14: amplitude is  56 */
-  /* depth 15: amplitude is  64 */
-
-  /* generate vibrato waves at depth 15 */
-  for (k = 0; k < 128; k++)
-  {
-    /* sine */
-    S_vib_table[0][15][k] = (short int) ((sin(TWO_PI * k / 128.0f) * 64) + 0.5f);
-  }
-
-  for (k = 0; k < 64; k++)
-  {
-    /* square */
-    S_vib_table[1][15][k] = 64;
-    S_vib_table[1][15][k + 64] = -64;
+  int num_samples;
 
-    /* saw */
-    S_vib_table[2][15][k] = k;
-    S_vib_table[2][15][k + 64] = k - 64;
-  }
-
-  for (k = 0; k < 32; k++)
-  {
-    /* triangle */
-    S_vib_table[3][15][k] = 2 * k;
-    S_vib_table[3][15][k + 32] = 64 - (2 * k);
-    S_vib_table[3][15][k + 64] = -(2 * k);
-    S_vib_table[3][15][k + 96] = -(64 - (2 * k));
-  }
-
-  /* generate waves at other depths */
-  for (i = 0; i < 4; i++)
-  {
-    for (k = 0; k < 128; k++)
-    {
-      S_vib_table[i][0][k] = 0;
-
-      S_vib_table[i][1][k] = S_vib_table[i][15][k] / 32;
-      S_vib_table[i][2][k] = S_vib_table[i][15][k] / 16;
-      S_vib_table[i][3][k] = (3 * S_vib_table[i][15][k]) / 32;
-      S_vib_table[i][4][k] = S_vib_table[i][15][k] / 8;
-      S_vib_table[i][5][k] = (5 * S_vib_table[i][15][k]) / 32;
-      S_vib_table[i][6][k] = (3 * S_vib_table[i][15][k]) / 16;
-      S_vib_table[i][7][k] = S_vib_table[i][15][k] / 4;
-      S_vib_table[i][8][k] = (5 * S_vib_table[i][15][k]) / 16;
-      S_vib_table[i][9][k] = (3 * S_vib_table[i][15][k]) / 8;
-      S_vib_table[i][10][k] = (7 * S_vib_table[i][15][k]) / 16;
-      S_vib_table[i][11][k] = S_vib_table[i][15][k] / 2;
-      S_vib_table[i][12][k] = (5 * S_vib_table[i][15][k]) / 8;
-      S_vib_table[i][13][k] = (3 * S_vib_table[i][15][k]) / 4;
-      S_vib_table[i][14][k] = (7 * S_vib_table[i][15][k]) / 8;
-    }
-  }
-
-  /* tremolo tables */
-
-  /* depth  0: amplitude is   0 */
-  /* depth  1: amplitude is  16 */
-  /* depth  2: amplitude is  24 */
-  /* depth  3: amplitude is  32 */
-  /* depth  4: amplitude is  40 */
-  /* depth  5: amplitude is  48 */
-  /* depth  6: amplitude is  56 */
-  /* depth  7: amplitude is  64 */
-  /* depth  8: amplitude is  72 */
-  /* depth  9: amplitude is  80 */
-  /* depth 10: amplitude is  88 */
-  /* depth 11: amplitude is  96 */
-  /* depth 12: amplitude is 104 */
-  /* depth 13: amplitude is 112 */
-  /* depth 14: amplitude is 120 */
-  /* depth 15: amplitude is 128 */
-
-  /* generate waves at depth 15 */
-  for (k = 0; k < 64; k++)
-  {
-    /* square */
-    S_trem_table[1][15][k] = 0;
-    S_trem_table[1][15][k + 64] = 128;
-
-    /* triangle */
-    S_trem_table[3][15][k] = 2 * k;
-    S_trem_table[3][15][k + 64] = 128 - (2 * k);
-  }
-
-  for (k = 0; k < 128; k++)
-  {
-    /* sine */
-    S_trem_table[0][15][k] = (short int) (((1.0f - cos(TWO_PI * k / 128.0f)) * 64) + 0.5f);
+  if (l == NULL)
+    return 0;
 
-    /* saw */
-    S_trem_table[2][15][k] = k;
-  }
+  /* a row of zeros never changes the level */
+  if (l->flat && (l->level == 0))
+    return max_samples;
 
-  /* generate waves at other depths */
-  for (i = 0; i < 4; i++)
+  /* initial delay: the level stays at 0 until the cycles reach 0 */
+  if (l->cycles < -1)
   {
-    for (k = 0; k < 128; k++)
-    {
-      S_trem_table[i][0][k] = 0;
-
-      S_trem_table[i][1][k] = S_trem_table[i][15][k] / 8;
-      S_trem_table[i][2][k] = (3 * S_trem_table[i][15][k]) / 16;
-      S_trem_table[i][3][k] = S_trem_table[i][15][k] / 4;
-      S_trem_table[i][4][k] = (5 * S_trem_table[i][15][k]) / 16;
-      S_trem_table[i][5][k] = (3 * S_trem_table[i][15][k]) / 8;
-      S_trem_table[i][6][k] = (7 * S_trem_table[i][15][k]) / 16;
-      S_trem_table[i][7][k] = S_trem_table[i][15][k] / 2;
-      S_trem_table[i][8][k] = (9 * S_trem_table[i][15][k]) / 16;
-      S_trem_table[i][9][k] = (5 * S_trem_table[i][15][k]) / 8;
-      S_trem_table[i][10][k] = (11 * S_trem_table[i][15][k]) / 16;
-      S_trem_table[i][11][k] = (3 * S_trem_table[i][15][k]) / 4;
-      S_trem_table[i][12][k] = (13 * S_trem_table[i][15][k]) / 16;
-      S_trem_table[i][13][k] = (7 * S_trem_table[i][15][k]) / 8;
-      S_trem_table[i][14][k] = (15 * S_trem_table[i][15][k]) / 16;
-    }
-  }
+    if (l->level != 0)
+      return 0;
 
-  /* wobble tables */
-
-  /* depth  0: amplitude is   0 */
-  /* depth  1: amplitude is  32 */
-  /* depth  2: amplitude is  48 */
-  /* depth  3: amplitude is  64 */
-  /* depth  4: amplitude is  80 */
-  /* depth  5: amplitude is  96 */
-  /* depth  6: amplitude is 112 */
-  /* depth  7: amplitude is 128 */
-  /* depth  8: amplitude is 144 */
-  /* depth  9: amplitude is 160 */
-  /* depth 10: amplitude is 176 */
-  /* depth 11: amplitude is 192 */
-  /* depth 12: amplitude is 208 */
-  /* depth 13: amplitude is 224 */
-  /* depth 14: amplitude is 240 */
-  /* depth 15: amplitude is 256 */
-
-  /* generate wobble waves at depth 15 */
-  for (k = 0; k < 128; k++)
-  {
-    /* sine */
-    S_wob_table[0][15][k] = (short int) ((sin(TWO_PI * k / 128.0f) * 256) + 0.5f);
+    num_samples = -l->cycles - 1;
   }
-
-  for (k = 0; k < 64; k++)
+  else if (l->cycles == -1)
+    return 0;
+  /* otherwise, the level changes when the table index advances */
+  else
   {
-    /* square */
-    S_wob_table[1][15][k] = 256;
-    S_wob_table[1][15][k + 64] = -256;
+    if (l->level != lfo_lookup(l))
+      return 0;
 
-    /* saw */
-    S_wob_table[2][15][k] = 4 * k;
-    S_wob_table[2][15][k + 64] = (4 * k) - 256;
-  }
+    num_samples = l->period - l->cycles - 1;
 
-  for (k = 0; k < 32; k++)
-  {
-    /* triangle */
-    S_wob_table[3][15][k] = 8 * k;
-    S_wob_table[3][15][k + 32] = 256 - (8 * k);
-    S_wob_table[3][15][k + 64] = -(8 * k);
-    S_wob_table[3][15][k + 96] = -(256 - (8 * k));
+    if (num_samples < 0)
+      return 0;
   }
 
-  /* generate waves at other depths */
-  for (i = 0; i < 4; i++)
-  {
-    for (k = 0; k < 128; k++)
-    {
-      S_wob_table[i][0][k] = 0;
-
-      S_wob_table[i][1][k] = S_wob_table[i][15][k] / 8;
-      S_wob_table[i][2][k] = (3 * S_wob_table[i][15][k]) / 16;
-      S_wob_table[i][3][k] = S_wob_table[i][15][k] / 4;
-      S_wob_table[i][4][k] = (5 * S_wob_table[i][15][k]) / 16;
-      S_wob_table[i][5][k] = (3 * S_wob_table[i][15][k]) / 8;
-      S_wob_table[i][6][k] = (7 * S_wob_table[i][15][k]) / 16;
-      S_wob_table[i][7][k] = S_wob_table[i][15][k] / 2;
-      S_wob_table[i][8][k] = (9 * S_wob_table[i][15][k]) / 16;
-      S_wob_table[i][9][k] = (5 * S_wob_table[i][15][k]) / 8;
-      S_wob_table[i][10][k] = (11 * S_wob_table[i][15][k]) / 16;
-      S_wob_table[i][11][k] = (3 * S_wob_table[i][15][k]) / 4;
-      S_wob_table[i][12][k] = (13 * S_wob_table[i][15][k]) / 16;
-      S_wob_table[i][13][k] = (7 * S_wob_table[i][15][k]) / 8;
-      S_wob_table[i][14][k] = (15 * S_wob_table[i][15][k]) / 16;
-    }
-  }
-
-  /* testing: print tables */
-#if 0
-  printf("Vibrato Sine Table (Depth 15):\n");
-
-  for (j = 0; j < 128; j++)
-    printf("  %d\n", S_vib_table[0][15][j]);
-#endif
+  if (num_samples > max_samples)
+    num_samples = max_samples;
 
-#if 0
-  printf("Vibrato Square Table (Depth 15):\n");
-
-  for (j = 0; j < 128; j++)
-    printf("  %d\n", S_vib_table[1][15][j]);
-#endif
-
-#if 0
-  printf("Vibrato Triangle Table (Depth 15):\n");
-
-  for (j = 0; j < 128; j++)
-    printf("  %d\n", S_vib_table[3][15][j]);
-#endif
-
-#if 0
-  printf("Vibrato Saw Table (Depth 15):\n");
-
-  for (j = 0; j < 128; j++)
-    printf("  %d\n", S_vib_table[2][15][j]);
-#endif
-
-#if 0
-  printf("Tremolo Sine Table (Depth 15):\n");
+  return num_samples;
+}
 
-  for (j = 0; j < 128; j++)
-    printf("  %d\n", S_trem_table[0][15][j]);
-#endif
+/*******************************************************************************
+** lfo_advance()
+*******************************************************************************/
+short int lfo_advance(lfo* l, int num_samples)
+{
+  int num_steps;
 
-#if 0
-  printf("Tremolo Square Table (Depth 15):\n");
+  if (l == NULL)
+    return 1;
 
-  for (j = 0; j < 128; j++)
-    printf("  %d\n", S_trem_table[1][15][j]);
-#endif
+  if (num_samples <= 0)
+    return 0;
 
-#if 0
-  printf("Tremolo Triangle Table (Depth 15):\n");
+  /* same as num_samples updates that do not change the level */
+  /* (see lfo_samples_until_change)                           */
+  l->cycles += num_samples;
 
-  for (j = 0; j < 128; j++)
-    printf("  %d\n", S_trem_table[3][15][j]);
-#endif
+  if ((l->cycles < 0) || (l->cycles < l->period) || (l->period <= 0))
+    return 0;
 
-#if 0
-  printf("Tremolo Saw Table (Depth 15):\n");
+  /* a row of zeros: the table index still advances */
+  num_steps = l->cycles / l->period;
 
-  for (j = 0; j < 128; j++)
-    printf("  %d\n", S_trem_table[2][15][j]);
-#endif
+  l->cycles -= num_steps * l->period;
 
-#if 0
-  printf("Wobble Sine Table (Depth 15):\n");
+  if (l->waveform == LFO_WAVEFORM_NOISE)
+    lfo_step_noise(l, num_steps);
+  else
+    l->index = (l->index + num_steps) % 128;
 
-  for (j = 0; j < 128; j++)
-    printf("  %d\n", S_wob_table[0][15][j]);
-#endif
+  return 0;
+}
 
-#if 0
-  printf("Wobble Square Table (Depth 15):\n");
+/*******************************************************************************
+** lfo_render_block()
+*******************************************************************************/
+short int lfo_render_block(lfo* l, int* level, int num_samples)
+{
+  int i;
+  int j;
+  int m;
 
-  for (j = 0; j < 128; j++)
-    printf("  %d\n", S_wob_table[1][15][j]);
-#endif
+  if (l == NULL)
+    return 1;
 
-#if 0
-  printf("Wobble Triangle Table (Depth 15):\n");
+  for (i = 0; i < num_samples; i += m)
+  {
+    m = lfo_samples_until_change(l, num_samples - i);
 
-  for (j = 0; j < 128; j++)
-    printf("  %d\n", S_wob_table[3][15][j]);
-#endif
+    /* constant stretch */
+    if (m > 0)
+    {
+      for (j = 0; j < m; j++)
+        level[i + j] = l->level;
 
-#if 0
-  printf("Wobble Saw Table (Depth 15):\n");
+      lfo_advance(l, m);
+    }
+    /* step */
+    else
+    {
+      lfo_update(l);
+      level[i] = l->level;
 
-  for (j = 0; j < 128; j++)
-    printf("  %d\n", S_wob_table[2][15][j]);
-#endif
+      m = 1;
+    }
+  }
 
   return 0;
 }
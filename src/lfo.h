@@ -37,8 +37,14 @@ typedef struct lfo
   unsigned char index;
   unsigned char depth;
 
-  /* noise generator */
-  unsigned int  lfsr;
+  /* table row for the type, waveform & depth (resolved at setup), */
+  /* whether it is read backwards, and whether it is all zeros     */
+  const short int*  row;
+  int               reverse;
+  int               flat;
+
+  /* noise generator (position in the lfsr sequence) */
+  int           noise_index;
 
   /* level */
   short int     level;
@@ -56,6 +62,8 @@ short int lfo_setup(lfo* l, int waveform,
                             unsigned char delay);
 short int lfo_update(lfo* l);
 
-short int lfo_generate_tables();
+int       lfo_samples_until_change(lfo* l, int max_samples);
+short int lfo_advance(lfo* l, int num_samples);
+short int lfo_render_block(lfo* l, int* level, int num_samples);
 
 #endif
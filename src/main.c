@@ -6,219 +6,547 @@
 ** main.c
 *******************************************************************************/
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-#include "clock.h"
-#include "datatree.h"
-#include "downsamp.h"
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "context.h"
 #include "export.h"
-#include "global.h"
-#include "parse.h"
-#include "sequence.h"
-#include "shaping.h"
-#include "synth.h"
-#include "tuning.h"
-#include "synth.h"
-#include "waveform.h"
+#include "server.h"
+
+#define MAIN_BUFFER_SIZE 1024
 
 /*******************************************************************************
-** main()
+** main_add_song()
 *******************************************************************************/
-int main(int argc, char *argv[])
+static short int main_add_song( char*** names, int* num_names, int* max_names, 
+                                char* name)
 {
-  int   i;
+  char** new_names;
+
+  /* check that the name fits in the filename buffers */
+  if (strlen(name) > 251)
+  {
+    printf("Name %s is too long.\n", name);
+    return 1;
+  }
+
+  /* grow the list if necessary */
+  if (*num_names >= *max_names)
+  {
+    new_names = realloc(*names, sizeof(char*) * (*max_names + 64));
+
+    if (new_names == NULL)
+      return 1;
+
+    *names = new_names;
+    *max_names += 64;
+  }
+
+  (*names)[*num_names] = strdup(name);
+
+  if ((*names)[*num_names] == NULL)
+    return 1;
+
+  *num_names += 1;
+
+  return 0;
+}
+
+/*******************************************************************************
+** main_compare_names()
+*******************************************************************************/
+static int main_compare_names(const void* a, const void* b)
+{
+  return strcmp(*((char**) a), *((char**) b));
+}
+
+/*******************************************************************************
+** main_add_directory()
+*******************************************************************************/
+static short int main_add_directory(char*** names, int* num_names, int* max_names, 
+                                    char* dirname)
+{
+  DIR*            dir;
+  struct dirent*  entry;
+
+  char  name[256];
+  int   length;
+  int   first;
+
+  dir = opendir(dirname);
 
-  char* name;
+  if (dir == NULL)
+  {
+    printf("Directory %s not opened.\n", dirname);
+    return 1;
+  }
+
+  first = *num_names;
+
+  /* add each song file in the directory (name without the extension) */
+  while ((entry = readdir(dir)) != NULL)
+  {
+    length = strlen(entry->d_name);
+
+    if ((length <= 4) || strcmp(&entry->d_name[length - 4], ".txt"))
+      continue;
+
+    if (strlen(dirname) + length > 254)
+      continue;
+
+    sprintf(name, "%s/%s", dirname, entry->d_name);
+    name[strlen(name) - 4] = '\0';
+
+    if (main_add_song(names, num_names, max_names, name))
+    {
+      closedir(dir);
+      return 1;
+    }
+  }
+
+  closedir(dir);
+
+  /* render in a predictable order */
+  qsort(&(*names)[first], *num_names - first, sizeof(char*), main_compare_names);
+
+  return 0;
+}
+
+/*******************************************************************************
+** main_render_song()
+*******************************************************************************/
+static short int main_render_song(idunno_context* ctx, char* name, 
+                                  int num_threads)
+{
   char  input_filename[256];
   char  output_filename[256];
 
-  data_tree_node* root;
+  short int buffer[MAIN_BUFFER_SIZE];
+  int       num_frames;
 
-  int sample_index;
-  int time_elapsed;
+  exporter  ex;
 
-  float export_length;
+  short int result;
 
-  short int* sample_buffer;
-  short int* export_buffer;
+  /* initialization */
+  result = 1;
 
-  int sample_buffer_size;
-  int export_buffer_size;
+  exporter_init(&ex);
 
-  /* initialization */
-  i = 0;
+  /* determine input and output filenames */
+  strcpy(input_filename, name);
+  strcat(input_filename, ".txt");
 
-  name = NULL;
-  root = NULL;
+  strcpy(output_filename, name);
+  strcat(output_filename, ".wav");
 
-  sample_index = 0;
+  /* read input file */
+  idunno_context_set_threads(ctx, num_threads);
 
-  sample_buffer = NULL;
-  export_buffer = NULL;
+  if (idunno_context_load_file(ctx, input_filename))
+    goto cleanup;
 
-  /* read command line arguments */
-  i = 1;
+  /* open output file */
+  if (exporter_open_file(&ex, output_filename))
+  {
+    fprintf(stdout, "Output file %s not opened.\n", output_filename);
+    goto cleanup;
+  }
 
-  while (i < argc)
+  /* write the file on a separate thread while rendering */
+  if (exporter_start_thread(&ex))
+    fprintf(stdout, "Writer thread not started. Writing on the render thread.\n");
+
+  /* the header is finalized when the file is closed */
+  if (exporter_write_header(&ex, ctx->export_sampling, ctx->export_bitres))
   {
-    /* name */
-    if (!strcmp(argv[i], "-n"))
+    fprintf(stdout, "Output file %s header not written.\n", output_filename);
+    goto cleanup;
+  }
+
+  /* render the song and write to file */
+  do
+  {
+    num_frames = idunno_context_render(ctx, buffer, MAIN_BUFFER_SIZE);
+
+    if (num_frames > 0)
     {
-      i++;
-      if (i >= argc)
+      if (exporter_write_block(&ex, buffer, num_frames))
       {
-        printf("Insufficient number of arguments. ");
-        printf("Expected name. Exiting...\n");
-        return 0;
+        fprintf(stdout, "Output file %s not written.\n", output_filename);
+        goto cleanup;
       }
-
-      name = strdup(argv[i]);
-      i++;
     }
-    else
+  } while (num_frames > 0);
+
+  if (num_frames < 0)
+  {
+    fprintf(stdout, "Song %s not rendered.\n", name);
+    goto cleanup;
+  }
+
+  /* close output file */
+  if (exporter_close_file(&ex))
+  {
+    fprintf(stdout, "Output file %s not written.\n", output_filename);
+    goto cleanup;
+  }
+
+  result = 0;
+
+  /* cleanup */
+cleanup:
+  synth_stop_threads(&ctx->syn);
+  exporter_deinit(&ex);
+
+  return result;
+}
+
+/*******************************************************************************
+** main_render_batch()
+*******************************************************************************/
+static int main_render_batch( idunno_context* ctx, 
+                              char** names, int num_names, 
+                              int num_workers, int num_threads)
+{
+  int   i;
+
+  int   num_running;
+  int   num_failed;
+
+  int   status;
+  pid_t pid;
+
+  num_running = 0;
+  num_failed = 0;
+
+  /* render in this process */
+  if ((num_workers <= 1) || (num_names <= 1))
+  {
+    for (i = 0; i < num_names; i++)
     {
-      printf("Unknown command line argument %s. Exiting...\n", argv[i]);
-      return 0;
+      if (main_render_song(ctx, names[i], num_threads))
+        num_failed += 1;
     }
+
+    return num_failed;
   }
 
-  /* make sure name is defined */
-  if (name == NULL)
+  /* render each song in a child process; the children share */
+  /* the tables that were generated in advance, and each one  */
+  /* works on its own copy of the context                     */
+  for (i = 0; i < num_names; i++)
   {
-    printf("Name not defined. Exiting...\n");
-    return 0;
-  }
+    /* wait for a worker to finish */
+    if (num_running >= num_workers)
+    {
+      if (wait(&status) > 0)
+      {
+        if (!WIFEXITED(status) || (WEXITSTATUS(status) != 0))
+          num_failed += 1;
 
-  /* determine input and output filenames */
-  strncpy(input_filename, name, 252);
-  strncat(input_filename, ".txt", 4);
+        num_running -= 1;
+      }
+    }
 
-  strncpy(output_filename, name, 252);
-  strncat(output_filename, ".wav", 4);
+    fflush(stdout);
 
-  /* setup */
-  globals_init();
-  export_init();
+    pid = fork();
 
-  /* read input file */
-  root = parse_file_to_data_tree(input_filename);
+    /* the worker flushes its messages, since _exit() does not */
+    if (pid == 0)
+    {
+      status = main_render_song(ctx, names[i], num_threads);
+      fflush(stdout);
+      _exit(status);
+    }
+    else if (pid < 0)
+    {
+      /* could not start a worker, so render the song here */
+      if (main_render_song(ctx, names[i], num_threads))
+        num_failed += 1;
+    }
+    else
+      num_running += 1;
+  }
 
-  if (root == NULL)
+  /* wait for the remaining workers */
+  while (num_running > 0)
   {
-    printf("Data tree not created from input file. Exiting...\n");
-    goto cleanup;
+    if (wait(&status) <= 0)
+      break;
+
+    if (!WIFEXITED(status) || (WEXITSTATUS(status) != 0))
+      num_failed += 1;
+
+    num_running -= 1;
   }
 
-  parse_data_tree_to_globals(root);
-  data_tree_node_destroy_tree(root);
-  root = NULL;
+  return num_failed;
+}
+
+/*******************************************************************************
+** main()
+*******************************************************************************/
+int main(int argc, char *argv[])
+{
+  int     i;
 
-  /* initialize tables */
-  tuning_generate_tables();
-  shaping_generate_tables();
-  lfo_generate_tables();
-  waveform_generate_tables();
-  sequencer_generate_tables();
-  downsamp_compute_sinc_filter();
+  char**  names;
+  int     num_names;
+  int     max_names;
 
-  /* determine buffer sizes */
-  export_length = sequencer_calculate_length(&G_sequencer);
+  int     num_threads;
+  int     num_voices;
+  int     control_period;
+  int     num_workers;
+  int     num_failed;
 
-  sample_buffer_size = (int) (export_length * GENESIS_PER_OP_FM_CLOCK);
-  export_buffer_size = (int) (export_length * G_export_sampling);
+  int     serve_stdin;
+  char*   socket_path;
 
-  /* allocate buffers */
-  sample_buffer = malloc(sizeof(short int) * sample_buffer_size);
+  idunno_context* ctx;
 
-  if (sample_buffer == NULL)
-    goto cleanup;
+  int     result;
 
-  export_buffer = malloc(sizeof(short int) * export_buffer_size);
+  /* initialization */
+  result = 1;
 
-  if (export_buffer == NULL)
-    goto cleanup;
+  ctx = NULL;
+  names = NULL;
+  num_names = 0;
+  max_names = 0;
 
-  /* setup synth, reset sequencer */
-  synth_setup(&G_synth);
-  sequencer_reset(&G_sequencer);
+  num_threads = 1;
+  num_voices = SYNTH_DEFAULT_VOICES;
+  control_period = FILTER_DEFAULT_CONTROL_PERIOD;
+  num_workers = 1;
+  num_failed = 0;
 
-  /* sound generation start */
-  sample_index = 0;
-  time_elapsed = 0;
+  serve_stdin = 0;
+  socket_path = NULL;
 
-  sequencer_activate_step(&G_sequencer, &G_synth);
+  /* read command line arguments */
+  i = 1;
 
-  while (sample_index < sample_buffer_size)
+  while (i < argc)
   {
-    /* update sequencer */
-    if (time_elapsed >= G_sequencer_period_table[G_bpm - 32])
+    /* name (may be given more than once) */
+    if (!strcmp(argv[i], "-n"))
     {
-      sequencer_ahead_one_tick(&G_sequencer, &G_synth);
-      time_elapsed -= G_sequencer_period_table[G_bpm - 32];
+      i++;
+      if (i >= argc)
+      {
+        printf("Insufficient number of arguments. ");
+        printf("Expected name. Exiting...\n");
+        goto cleanup;
+      }
+
+      if (main_add_song(&names, &num_names, &max_names, argv[i]))
+        goto cleanup;
+
+      i++;
     }
+    /* directory of songs */
+    else if (!strcmp(argv[i], "-d"))
+    {
+      i++;
+      if (i >= argc)
+      {
+        printf("Insufficient number of arguments. ");
+        printf("Expected directory. Exiting...\n");
+        goto cleanup;
+      }
 
-    /* update voice */
-    synth_update(&G_synth);
+      if (main_add_directory(&names, &num_names, &max_names, argv[i]))
+        goto cleanup;
 
-    /* add sample to buffer */
-    if (G_synth.level > 32767)
-      sample_buffer[sample_index] = 32767;
-    else if (G_synth.level < -32767)
-      sample_buffer[sample_index] = -32767;
-    else
-      sample_buffer[sample_index] = (short int) G_synth.level;
+      i++;
+    }
+    /* number of threads */
+    else if (!strcmp(argv[i], "-j"))
+    {
+      i++;
+      if (i >= argc)
+      {
+        printf("Insufficient number of arguments. ");
+        printf("Expected number of threads. Exiting...\n");
+        goto cleanup;
+      }
+
+      num_threads = atoi(argv[i]);
+
+      if (num_threads < 1)
+      {
+        printf("Invalid number of threads specified. Defaulting to 1.\n");
+        num_threads = 1;
+      }
+
+      i++;
+    }
+    /* number of voices */
+    else if (!strcmp(argv[i], "-v"))
+    {
+      i++;
+      if (i >= argc)
+      {
+        printf("Insufficient number of arguments. ");
+        printf("Expected number of voices. Exiting...\n");
+        return 0;
+      }
 
-    sample_index += 1;
+      num_voices = atoi(argv[i]);
 
-    /* update time elapsed */
-    time_elapsed += GENESIS_DELTA_T_NANOSECONDS;
+      if ((num_voices < 1) || (num_voices > SYNTH_MAX_VOICES))
+      {
+        printf("Invalid number of voices specified. Defaulting to %d.\n", 
+                SYNTH_DEFAULT_VOICES);
+        num_voices = SYNTH_DEFAULT_VOICES;
+      }
+
+      i++;
+    }
+    /* filter control period */
+    else if (!strcmp(argv[i], "-c"))
+    {
+      i++;
+      if (i >= argc)
+      {
+        printf("Insufficient number of arguments. ");
+        printf("Expected control period. Exiting...\n");
+        return 0;
+      }
+
+      control_period = atoi(argv[i]);
+
+      if ((control_period < 1) || (control_period > FILTER_MAX_CONTROL_PERIOD))
+      {
+        printf("Invalid control period specified. Defaulting to %d.\n", 
+                FILTER_DEFAULT_CONTROL_PERIOD);
+        control_period = FILTER_DEFAULT_CONTROL_PERIOD;
+      }
+
+      i++;
+    }
+    /* number of worker processes */
+    else if (!strcmp(argv[i], "-w"))
+    {
+      i++;
+      if (i >= argc)
+      {
+        printf("Insufficient number of arguments. ");
+        printf("Expected number of workers. Exiting...\n");
+        goto cleanup;
+      }
+
+      num_workers = atoi(argv[i]);
+
+      if (num_workers < 1)
+      {
+        printf("Invalid number of workers specified. Defaulting to 1.\n");
+        num_workers = 1;
+      }
+
+      i++;
+    }
+    /* serve render jobs from standard input */
+    else if (!strcmp(argv[i], "-s"))
+    {
+      serve_stdin = 1;
+      i++;
+    }
+    /* serve render jobs from a socket */
+    else if (!strcmp(argv[i], "-u"))
+    {
+      i++;
+      if (i >= argc)
+      {
+        printf("Insufficient number of arguments. ");
+        printf("Expected socket path. Exiting...\n");
+        return 0;
+      }
+
+      socket_path = argv[i];
+      i++;
+    }
+    else
+    {
+      printf("Unknown command line argument %s. Exiting...\n", argv[i]);
+      goto cleanup;
+    }
   }
 
-  /* downsample */
-  if (G_export_sampling != 53267)
+  /* make sure name is defined */
+  if ((num_names == 0) && (!serve_stdin) && (socket_path == NULL))
   {
-    downsamp_apply_filter(sample_buffer, sample_buffer_size);
-
-    downsamp_perform_downsample(sample_buffer, sample_buffer_size, 
-                                export_buffer, export_buffer_size);
+    printf("Name not defined. Exiting...\n");
+    goto cleanup;
   }
-  else
+
+  /* create the render context; this generates the shared tables */
+  ctx = idunno_context_create();
+
+  if (ctx == NULL)
   {
-    memcpy(export_buffer, sample_buffer, export_buffer_size);
+    printf("Render context not created. Exiting...\n");
+    goto cleanup;
   }
 
-  /* open output file */
-  if (export_open_file(output_filename))
+  idunno_context_set_voices(ctx, num_voices);
+  idunno_context_set_control_period(ctx, control_period);
+
+  /* compute the song dependent tables for the default settings, */
+  /* so that they are shared with the workers that use them       */
+  idunno_context_update_tables(ctx);
+
+  /* serve render jobs; the tables stay resident between jobs */
+  if (serve_stdin || (socket_path != NULL))
   {
-    fprintf(stdout, "Output file not opened. Exiting...\n");
+    idunno_context_set_threads(ctx, num_threads);
+
+    if (serve_stdin)
+      result = server_run_stdin(ctx);
+    else
+      result = server_run_socket(ctx, socket_path);
+
     goto cleanup;
   }
 
-  /* write to file */
-  export_write_header(export_buffer_size);
-  export_write_block(export_buffer, export_buffer_size);
+  /* render songs */
+  num_failed = main_render_batch( ctx, names, num_names, 
+                                  num_workers, num_threads);
 
-  /* close output file */
-  export_close_file();
+  if (num_names > 1)
+    printf("Rendered %d of %d songs.\n", num_names - num_failed, num_names);
+
+  /* the exit status reports whether any song failed */
+  if (num_failed == 0)
+    result = 0;
 
   /* cleanup */
 cleanup:
-  if (sample_buffer != NULL)
+  if (ctx != NULL)
   {
-    free(sample_buffer);
-    sample_buffer = NULL;
+    idunno_context_destroy(ctx);
+    ctx = NULL;
   }
 
-  if (export_buffer != NULL)
+  if (names != NULL)
   {
-    free(export_buffer);
-    export_buffer = NULL;
-  }
+    for (i = 0; i < num_names; i++)
+      free(names[i]);
 
-  export_deinit();
-  globals_deinit();
+    free(names);
+    names = NULL;
+  }
 
-  return 0;
+  return result;
 }
@@ -2,12 +2,14 @@
 ** parse.c (parsing functions)
 *******************************************************************************/
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>    /* testing */
 #include <stdlib.h>
 #include <string.h>
 
+#include "context.h"
 #include "datatree.h"
-#include "global.h"
 #include "parse.h"
 #include "sequence.h"
 #include "synth.h"
@@ -16,17 +18,16 @@
 #include "waveform.h"
 
 #define PARSE_EAT_TOKEN(just_eat_it)                                           \
-  if (t.token == just_eat_it)                                                  \
-    tokenizer_advance(&t);                                                     \
+  if (t->token == just_eat_it)                                                 \
+    tokenizer_advance(t);                                                      \
   else                                                                         \
     goto houston;
 
 /*******************************************************************************
-** parse_file_to_data_tree()
+** parse_tokens_to_data_tree()
 *******************************************************************************/
-data_tree_node* parse_file_to_data_tree(char* filename)
+static data_tree_node* parse_tokens_to_data_tree(tokenizer* t)
 {
-  tokenizer         t;
   data_tree_node*   root;
   data_tree_node*   current;
   data_tree_node**  stack;
@@ -34,12 +35,6 @@ data_tree_node* parse_file_to_data_tree(char* filename)
   int               stack_top;
   int               parse_state;
 
-  /* initialize tokenizer and open file */
-  tokenizer_init(&t);
-
-  if (tokenizer_open_file(&t, filename))
-    return NULL;
-
   /* setup stack */
   stack = malloc(DATA_TREE_STACK_INITIAL_SIZE * sizeof(data_tree_node*));
   stack_size = DATA_TREE_STACK_INITIAL_SIZE;
@@ -50,12 +45,12 @@ data_tree_node* parse_file_to_data_tree(char* filename)
 
   PARSE_EAT_TOKEN(TOKEN_LESS_THAN)
 
-  if ((t.token == TOKEN_IDENTIFIER) && (!strcmp(t.sb, "idunno")))
+  if ((t->token == TOKEN_IDENTIFIER) && (!strcmp(t->sb, "idunno")))
   {
     root->type = DATA_TREE_NODE_TYPE_FIELD_IDUNNO;
     current = root;
     DATA_TREE_PUSH_NODE(stack, root)
-    tokenizer_advance(&t);
+    tokenizer_advance(t);
   }
   else
     goto cleanup;
@@ -66,248 +61,248 @@ data_tree_node* parse_file_to_data_tree(char* filename)
   while (stack_top >= 0)
   {
     /* attribute */
-    if ((t.token == TOKEN_AT_SYMBOL) && 
+    if ((t->token == TOKEN_AT_SYMBOL) && 
         (parse_state == PARSE_STATE_ATTRIBUTE_SUBFIELD_OR_VALUE))
     {
       DATA_TREE_CREATE_NEW_NODE(stack, current)
-      tokenizer_advance(&t);
+      tokenizer_advance(t);
 
-      if (t.token != TOKEN_IDENTIFIER)
+      if (t->token != TOKEN_IDENTIFIER)
         goto houston;
 
-      if (!strcmp(t.sb, "bpm"))
+      if (!strcmp(t->sb, "bpm"))
         current->type = DATA_TREE_NODE_TYPE_ATTRIBUTE_BPM;
-      else if (!strcmp(t.sb, "export_sampling"))
+      else if (!strcmp(t->sb, "export_sampling"))
         current->type = DATA_TREE_NODE_TYPE_ATTRIBUTE_EXPORT_SAMPLING;
-      else if (!strcmp(t.sb, "export_bitres"))
+      else if (!strcmp(t->sb, "export_bitres"))
         current->type = DATA_TREE_NODE_TYPE_ATTRIBUTE_EXPORT_BITRES;
-      else if (!strcmp(t.sb, "downsampling_m"))
+      else if (!strcmp(t->sb, "downsampling_m"))
         current->type = DATA_TREE_NODE_TYPE_ATTRIBUTE_DOWNSAMPLING_M;
-      else if (!strcmp(t.sb, "tuning_system"))
+      else if (!strcmp(t->sb, "tuning_system"))
         current->type = DATA_TREE_NODE_TYPE_ATTRIBUTE_TUNING_SYSTEM;
-      else if (!strcmp(t.sb, "tuning_fork"))
+      else if (!strcmp(t->sb, "tuning_fork"))
         current->type = DATA_TREE_NODE_TYPE_ATTRIBUTE_TUNING_FORK;
       else
         goto houston;
 
-      tokenizer_advance(&t);
+      tokenizer_advance(t);
 
       PARSE_EAT_TOKEN(TOKEN_EQUAL_SIGN)
 
-      if (t.token == TOKEN_NUMBER_INTEGER)
+      if (t->token == TOKEN_NUMBER_INTEGER)
       {
         current->child = data_tree_node_create();
         current->child->type = DATA_TREE_NODE_TYPE_VALUE_INTEGER;
-        current->child->value = strdup(t.sb);
+        current->child->value = strdup(t->sb);
       }
-      else if (t.token == TOKEN_STRING)
+      else if (t->token == TOKEN_STRING)
       {
         current->child = data_tree_node_create();
         current->child->type = DATA_TREE_NODE_TYPE_VALUE_STRING;
-        current->child->value = strdup(t.sb);
+        current->child->value = strdup(t->sb);
       }
       else
         goto houston;
 
-      tokenizer_advance(&t);
+      tokenizer_advance(t);
     }
     /* subfield */
-    else if ( (t.token == TOKEN_LESS_THAN) &&
+    else if ( (t->token == TOKEN_LESS_THAN) &&
               ( (parse_state == PARSE_STATE_ATTRIBUTE_SUBFIELD_OR_VALUE) ||
                 (parse_state == PARSE_STATE_SUBFIELD_OR_END_OF_FIELD)))
     {
       DATA_TREE_CREATE_NEW_NODE(stack, current)
-      tokenizer_advance(&t);
+      tokenizer_advance(t);
 
-      if (t.token != TOKEN_IDENTIFIER)
+      if (t->token != TOKEN_IDENTIFIER)
         goto houston;
 
       /* top level fields */
-      if (!strcmp(t.sb, "generator"))
+      if (!strcmp(t->sb, "generator"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_GENERATOR;
-      else if (!strcmp(t.sb, "noise"))
+      else if (!strcmp(t->sb, "noise"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_NOISE;
-      else if (!strcmp(t.sb, "filter"))
+      else if (!strcmp(t->sb, "filter"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_FILTER;
-      else if (!strcmp(t.sb, "reverb"))
+      else if (!strcmp(t->sb, "reverb"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_REVERB;
-      else if (!strcmp(t.sb, "amplitude_envelope"))
+      else if (!strcmp(t->sb, "amplitude_envelope"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_AMPLITUDE_ENVELOPE;
-      else if (!strcmp(t.sb, "filter_envelope"))
+      else if (!strcmp(t->sb, "filter_envelope"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_FILTER_ENVELOPE;
-      else if (!strcmp(t.sb, "vibrato"))
+      else if (!strcmp(t->sb, "vibrato"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_VIBRATO;
-      else if (!strcmp(t.sb, "tremolo"))
+      else if (!strcmp(t->sb, "tremolo"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_TREMOLO;
-      else if (!strcmp(t.sb, "wobble"))
+      else if (!strcmp(t->sb, "wobble"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_WOBBLE;
-      else if (!strcmp(t.sb, "hpf"))
+      else if (!strcmp(t->sb, "hpf"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_HPF;
-      else if (!strcmp(t.sb, "soft_clip"))
+      else if (!strcmp(t->sb, "soft_clip"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_SOFT_CLIP;
-      else if (!strcmp(t.sb, "sequencer"))
+      else if (!strcmp(t->sb, "sequencer"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_SEQUENCER;
       /* waveform generator fields */
-      else if (!strcmp(t.sb, "osc_1"))
+      else if (!strcmp(t->sb, "osc_1"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_OSC_1;
-      else if (!strcmp(t.sb, "osc_2"))
+      else if (!strcmp(t->sb, "osc_2"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_OSC_2;
-      else if (!strcmp(t.sb, "osc_3"))
+      else if (!strcmp(t->sb, "osc_3"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_OSC_3;
-      else if (!strcmp(t.sb, "phi"))
+      else if (!strcmp(t->sb, "phi"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_PHI;
-      else if (!strcmp(t.sb, "sync"))
+      else if (!strcmp(t->sb, "sync"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_SYNC;
-      else if (!strcmp(t.sb, "mix"))
+      else if (!strcmp(t->sb, "mix"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_MIX;
-      else if (!strcmp(t.sb, "ring_mod"))
+      else if (!strcmp(t->sb, "ring_mod"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_RING_MOD;
       /* oscillator fields */
-      else if (!strcmp(t.sb, "waveform"))
+      else if (!strcmp(t->sb, "waveform"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_WAVEFORM;
-      else if (!strcmp(t.sb, "detune_octave"))
+      else if (!strcmp(t->sb, "detune_octave"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_DETUNE_OCTAVE;
-      else if (!strcmp(t.sb, "detune_coarse"))
+      else if (!strcmp(t->sb, "detune_coarse"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_DETUNE_COARSE;
-      else if (!strcmp(t.sb, "detune_fine"))
+      else if (!strcmp(t->sb, "detune_fine"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_DETUNE_FINE;
       /* noise generator fields */
-      else if (!strcmp(t.sb, "period"))
+      else if (!strcmp(t->sb, "period"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_PERIOD;
       /* filter fields */
-      else if (!strcmp(t.sb, "cutoff"))
+      else if (!strcmp(t->sb, "cutoff"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_CUTOFF;
-      else if (!strcmp(t.sb, "keytrack"))
+      else if (!strcmp(t->sb, "keytrack"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_KEYTRACK;
-      else if (!strcmp(t.sb, "resonance"))
+      else if (!strcmp(t->sb, "resonance"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_RESONANCE;
       /* reverb fields */
-      else if (!strcmp(t.sb, "delay"))
+      else if (!strcmp(t->sb, "delay"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_DELAY;
-      else if (!strcmp(t.sb, "c_0"))
+      else if (!strcmp(t->sb, "c_0"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_C_0;
-      else if (!strcmp(t.sb, "c_1"))
+      else if (!strcmp(t->sb, "c_1"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_C_1;
-      else if (!strcmp(t.sb, "c_2"))
+      else if (!strcmp(t->sb, "c_2"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_C_2;
-      else if (!strcmp(t.sb, "c_3"))
+      else if (!strcmp(t->sb, "c_3"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_C_3;
-      else if (!strcmp(t.sb, "c_4"))
+      else if (!strcmp(t->sb, "c_4"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_C_4;
-      else if (!strcmp(t.sb, "c_5"))
+      else if (!strcmp(t->sb, "c_5"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_C_5;
-      else if (!strcmp(t.sb, "c_6"))
+      else if (!strcmp(t->sb, "c_6"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_C_6;
-      else if (!strcmp(t.sb, "c_7"))
+      else if (!strcmp(t->sb, "c_7"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_C_7;
-      else if (!strcmp(t.sb, "feedback"))
+      else if (!strcmp(t->sb, "feedback"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_FEEDBACK;
-      else if (!strcmp(t.sb, "volume"))
+      else if (!strcmp(t->sb, "volume"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_VOLUME;
       /* envelope fields */
-      else if (!strcmp(t.sb, "ar"))
+      else if (!strcmp(t->sb, "ar"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_AR;
-      else if (!strcmp(t.sb, "dr"))
+      else if (!strcmp(t->sb, "dr"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_DR;
-      else if (!strcmp(t.sb, "sr"))
+      else if (!strcmp(t->sb, "sr"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_SR;
-      else if (!strcmp(t.sb, "rr"))
+      else if (!strcmp(t->sb, "rr"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_RR;
-      else if (!strcmp(t.sb, "tl"))
+      else if (!strcmp(t->sb, "tl"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_TL;
-      else if (!strcmp(t.sb, "sl"))
+      else if (!strcmp(t->sb, "sl"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_SL;
-      else if (!strcmp(t.sb, "rks"))
+      else if (!strcmp(t->sb, "rks"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_RKS;
-      else if (!strcmp(t.sb, "lks"))
+      else if (!strcmp(t->sb, "lks"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_LKS;
       /* lfo fields */
-      else if (!strcmp(t.sb, "depth"))
+      else if (!strcmp(t->sb, "depth"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_DEPTH;
-      else if (!strcmp(t.sb, "speed"))
+      else if (!strcmp(t->sb, "speed"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_SPEED;
       /* sequencer fields */
-      else if (!strcmp(t.sb, "measure"))
+      else if (!strcmp(t->sb, "measure"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_MEASURE;
       /* measure fields */
-      else if (!strcmp(t.sb, "step"))
+      else if (!strcmp(t->sb, "step"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_STEP;
-      else if (!strcmp(t.sb, "length"))
+      else if (!strcmp(t->sb, "length"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_LENGTH;
-      else if (!strcmp(t.sb, "beat"))
+      else if (!strcmp(t->sb, "beat"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_BEAT;
-      else if (!strcmp(t.sb, "subdivisions"))
+      else if (!strcmp(t->sb, "subdivisions"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_SUBDIVISIONS;
       /* step fields */
-      else if (!strcmp(t.sb, "scale"))
+      else if (!strcmp(t->sb, "scale"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_SCALE;
-      else if (!strcmp(t.sb, "chord"))
+      else if (!strcmp(t->sb, "chord"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_CHORD;
-      else if (!strcmp(t.sb, "arpeggiator"))
+      else if (!strcmp(t->sb, "arpeggiator"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_ARPEGGIATOR;
-      else if (!strcmp(t.sb, "position"))
+      else if (!strcmp(t->sb, "position"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_POSITION;
-      else if (!strcmp(t.sb, "octave"))
+      else if (!strcmp(t->sb, "octave"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_OCTAVE;
-      else if (!strcmp(t.sb, "duration"))
+      else if (!strcmp(t->sb, "duration"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_DURATION;
       /* scale fields */
-      else if (!strcmp(t.sb, "name"))
+      else if (!strcmp(t->sb, "name"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_NAME;
-      else if (!strcmp(t.sb, "tonic"))
+      else if (!strcmp(t->sb, "tonic"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_TONIC;
       /* chord fields */
-      else if (!strcmp(t.sb, "note_1"))
+      else if (!strcmp(t->sb, "note_1"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_NOTE_1;
-      else if (!strcmp(t.sb, "note_2"))
+      else if (!strcmp(t->sb, "note_2"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_NOTE_2;
-      else if (!strcmp(t.sb, "note_3"))
+      else if (!strcmp(t->sb, "note_3"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_NOTE_3;
-      else if (!strcmp(t.sb, "note_4"))
+      else if (!strcmp(t->sb, "note_4"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_NOTE_4;
-      else if (!strcmp(t.sb, "note_5"))
+      else if (!strcmp(t->sb, "note_5"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_NOTE_5;
-      else if (!strcmp(t.sb, "note_6"))
+      else if (!strcmp(t->sb, "note_6"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_NOTE_6;
       /* arpeggiator fields */
-      else if (!strcmp(t.sb, "mode"))
+      else if (!strcmp(t->sb, "mode"))
         current->type = DATA_TREE_NODE_TYPE_FIELD_MODE;
       else
         goto houston;
 
       DATA_TREE_PUSH_NODE(stack, current)
-      tokenizer_advance(&t);
+      tokenizer_advance(t);
       parse_state = PARSE_STATE_ATTRIBUTE_SUBFIELD_OR_VALUE;
     }
     /* integer */
-    else if ( (t.token == TOKEN_NUMBER_INTEGER) &&
+    else if ( (t->token == TOKEN_NUMBER_INTEGER) &&
               (parse_state == PARSE_STATE_ATTRIBUTE_SUBFIELD_OR_VALUE))
     {
       DATA_TREE_CREATE_NEW_NODE(stack, current)
       current->type = DATA_TREE_NODE_TYPE_VALUE_INTEGER;
-      current->value = strdup(t.sb);
-      tokenizer_advance(&t);
+      current->value = strdup(t->sb);
+      tokenizer_advance(t);
       parse_state = PARSE_STATE_END_OF_FIELD;
     }
     /* string */
-    else if ( (t.token == TOKEN_STRING) &&
+    else if ( (t->token == TOKEN_STRING) &&
               (parse_state == PARSE_STATE_ATTRIBUTE_SUBFIELD_OR_VALUE))
 
     {
       DATA_TREE_CREATE_NEW_NODE(stack, current)
       current->type = DATA_TREE_NODE_TYPE_VALUE_STRING;
-      current->value = strdup(t.sb);
-      tokenizer_advance(&t);
+      current->value = strdup(t->sb);
+      tokenizer_advance(t);
       parse_state = PARSE_STATE_END_OF_FIELD;
     }
     /* end of field */
-    else if ( (t.token == TOKEN_GREATER_THAN) &&
+    else if ( (t->token == TOKEN_GREATER_THAN) &&
               ( (parse_state == PARSE_STATE_END_OF_FIELD) ||
                 (parse_state == PARSE_STATE_SUBFIELD_OR_END_OF_FIELD)))
     {
       current = stack[stack_top];
       DATA_TREE_POP_NODE(stack)
-      tokenizer_advance(&t);
+      tokenizer_advance(t);
       parse_state = PARSE_STATE_SUBFIELD_OR_END_OF_FIELD;
     }
     /* error */
@@ -328,7 +323,7 @@ houston:
     root = NULL;
   }
 
-  printf("Failed text file parsing on line number %d.\n", t.ln);
+  printf("Failed text file parsing on line number %d.\n", t->ln);
 
   /* cleanup */
 cleanup:
@@ -338,6 +333,47 @@ cleanup:
     stack = NULL;
   }
 
+  return root;
+}
+
+/*******************************************************************************
+** parse_file_to_data_tree()
+*******************************************************************************/
+data_tree_node* parse_file_to_data_tree(char* filename)
+{
+  tokenizer       t;
+  data_tree_node* root;
+
+  /* initialize tokenizer and open file */
+  tokenizer_init(&t);
+
+  if (tokenizer_open_file(&t, filename))
+    return NULL;
+
+  root = parse_tokens_to_data_tree(&t);
+
+  tokenizer_close_file(&t);
+  tokenizer_deinit(&t);
+
+  return root;
+}
+
+/*******************************************************************************
+** parse_memory_to_data_tree()
+*******************************************************************************/
+data_tree_node* parse_memory_to_data_tree(char* buffer, int size)
+{
+  tokenizer       t;
+  data_tree_node* root;
+
+  /* initialize tokenizer and read from the buffer */
+  tokenizer_init(&t);
+
+  if (tokenizer_open_memory(&t, buffer, size))
+    return NULL;
+
+  root = parse_tokens_to_data_tree(&t);
+
   tokenizer_close_file(&t);
   tokenizer_deinit(&t);
 
@@ -765,7 +801,8 @@ char parse_data_tree_lookup_midi_note(char* name)
 /*******************************************************************************
 ** parse_data_tree_load_integer()
 *******************************************************************************/
-short int parse_data_tree_load_integer(int val, int parent_type, int grand_type)
+short int parse_data_tree_load_integer( idunno_context* ctx, int val, 
+                                        int parent_type, int grand_type)
 {
   int       num;
 
@@ -773,10 +810,18 @@ short int parse_data_tree_load_integer(int val, int parent_type, int grand_type)
   measure*  m;
   step*     st;
 
-  p = &G_synth.p;
+  p = &ctx->syn.p;
+
+  /* these are only used for values inside of a measure or step */
+  if (ctx->seq.num_measures > 0)
+    m = &ctx->seq.measures[ctx->seq.num_measures - 1];
+  else
+    m = &ctx->seq.measures[0];
 
-  m = &G_sequencer.measures[G_sequencer.num_measures - 1];
-  st = &m->steps[m->num_steps - 1];
+  if (m->num_steps > 0)
+    st = &m->steps[m->num_steps - 1];
+  else
+    st = &m->steps[0];
 
   /* highpass filter */
   if (parent_type == DATA_TREE_NODE_TYPE_FIELD_HPF)
@@ -1492,11 +1537,11 @@ short int parse_data_tree_load_integer(int val, int parent_type, int grand_type)
   else if (parent_type == DATA_TREE_NODE_TYPE_ATTRIBUTE_BPM)
   {
     if ((val >= 32) && (val <= 255))
-      G_bpm = val;
+      ctx->bpm = val;
     else
     {
       printf("Invalid BPM specified. Defaulting to 120.\n");
-      G_bpm = 120;
+      ctx->bpm = 120;
     }
   }
   /* export sampling rate */
@@ -1504,60 +1549,56 @@ short int parse_data_tree_load_integer(int val, int parent_type, int grand_type)
   {
     if (val == 8363)
     {
-      G_export_sampling = 8363;
-      G_export_period = 119574;
+      ctx->export_sampling = 8363;
+      ctx->export_period = 119574;
     }
     else if (val == 16726)
     {
-      G_export_sampling = 16726;
-      G_export_period = 59787;
+      ctx->export_sampling = 16726;
+      ctx->export_period = 59787;
     }
     else if (val == 22050)
     {
-      G_export_sampling = 22050;
-      G_export_period = 45351;
+      ctx->export_sampling = 22050;
+      ctx->export_period = 45351;
     }
     else if (val == 44100)
     {
-      G_export_sampling = 44100;
-      G_export_period = 22676;
+      ctx->export_sampling = 44100;
+      ctx->export_period = 22676;
     }
     else if (val == 53267)
     {
-      G_export_sampling = 53267;
-      G_export_period = 18773;
+      ctx->export_sampling = 53267;
+      ctx->export_period = 18773;
     }
     else
     {
       printf("Invalid export sampling rate specified. Defaulting to 44100 hz.\n");
-      G_export_sampling = 44100;
-      G_export_period = 22676;
+      ctx->export_sampling = 44100;
+      ctx->export_period = 22676;
     }
   }
   /* export bit resolution */
   else if (parent_type == DATA_TREE_NODE_TYPE_ATTRIBUTE_EXPORT_BITRES)
   {
-    if ((val == 8) || (val == 16))
-      G_export_bitres = val;
+    if ((val == 8) || (val == 16) || (val == 24) || (val == 32))
+      ctx->export_bitres = val;
     else
     {
       printf("Invalid export bitres specified. Defaulting to 16 bit.\n");
-      G_export_bitres = 16;
+      ctx->export_bitres = 16;
     }
   }
   /* downsampling m */
   else if (parent_type == DATA_TREE_NODE_TYPE_ATTRIBUTE_DOWNSAMPLING_M)
   {
     if ((val == 64) || (val == 128) || (val == 256) || (val == 512))
-    {
-      G_downsampling_m = val;
-      G_downsampling_bound = (G_downsampling_m / 2) + 1;
-    }
+      ctx->downsampling_m = val;
     else
     {
       printf("Invalid downsampling M specified. Defaulting to 128.\n");
-      G_downsampling_m = 128;
-      G_downsampling_bound = (G_downsampling_m / 2) + 1;
+      ctx->downsampling_m = 128;
     }
   }
 
@@ -1567,7 +1608,7 @@ short int parse_data_tree_load_integer(int val, int parent_type, int grand_type)
 /*******************************************************************************
 ** parse_data_tree_load_string()
 *******************************************************************************/
-short int parse_data_tree_load_string(char* name, 
+short int parse_data_tree_load_string(idunno_context* ctx, char* name, 
                                       int parent_type, int grand_type)
 {
   int       num;
@@ -1579,10 +1620,18 @@ short int parse_data_tree_load_string(char* name,
   if (name == NULL)
     return 1;
 
-  p = &G_synth.p;
+  p = &ctx->syn.p;
 
-  m = &G_sequencer.measures[G_sequencer.num_measures - 1];
-  st = &m->steps[m->num_steps - 1];
+  /* these are only used for values inside of a measure or step */
+  if (ctx->seq.num_measures > 0)
+    m = &ctx->seq.measures[ctx->seq.num_measures - 1];
+  else
+    m = &ctx->seq.measures[0];
+
+  if (m->num_steps > 0)
+    st = &m->steps[m->num_steps - 1];
+  else
+    st = &m->steps[0];
 
   /* waveform */
   if (parent_type == DATA_TREE_NODE_TYPE_FIELD_WAVEFORM)
@@ -1930,44 +1979,44 @@ short int parse_data_tree_load_string(char* name,
   else if (parent_type == DATA_TREE_NODE_TYPE_ATTRIBUTE_TUNING_SYSTEM)
   {
     if (!strcmp(name, "equal_temperament"))
-      G_tuning_system = TUNING_SYSTEM_12_ET;
+      ctx->tuning_system = TUNING_SYSTEM_12_ET;
     else if (!strcmp(name, "pythagorean"))
-      G_tuning_system = TUNING_SYSTEM_PYTHAGOREAN;
+      ctx->tuning_system = TUNING_SYSTEM_PYTHAGOREAN;
     else if (!strcmp(name, "quarter_comma_meantone"))
-      G_tuning_system = TUNING_SYSTEM_QC_MEANTONE;
+      ctx->tuning_system = TUNING_SYSTEM_QC_MEANTONE;
     else if (!strcmp(name, "just_intonation"))
-      G_tuning_system = TUNING_SYSTEM_JUST;
+      ctx->tuning_system = TUNING_SYSTEM_JUST;
     else if (!strcmp(name, "werckmeister_iii"))
-      G_tuning_system = TUNING_SYSTEM_WERCKMEISTER_III;
+      ctx->tuning_system = TUNING_SYSTEM_WERCKMEISTER_III;
     else if (!strcmp(name, "werckmeister_iv"))
-      G_tuning_system = TUNING_SYSTEM_WERCKMEISTER_IV;
+      ctx->tuning_system = TUNING_SYSTEM_WERCKMEISTER_IV;
     else if (!strcmp(name, "werckmeister_v"))
-      G_tuning_system = TUNING_SYSTEM_WERCKMEISTER_V;
+      ctx->tuning_system = TUNING_SYSTEM_WERCKMEISTER_V;
     else if (!strcmp(name, "werckmeister_vi"))
-      G_tuning_system = TUNING_SYSTEM_WERCKMEISTER_VI;
+      ctx->tuning_system = TUNING_SYSTEM_WERCKMEISTER_VI;
     else if (!strcmp(name, "renold_i"))
-      G_tuning_system = TUNING_SYSTEM_RENOLD_I;
+      ctx->tuning_system = TUNING_SYSTEM_RENOLD_I;
     else
     {
       printf("Invalid tuning system specified. Defaulting to Equal Temperament.\n");
-      G_tuning_system = TUNING_SYSTEM_12_ET;
+      ctx->tuning_system = TUNING_SYSTEM_12_ET;
     }
   }
   /* tuning fork */
   else if (parent_type == DATA_TREE_NODE_TYPE_ATTRIBUTE_TUNING_FORK)
   {
     if (!strcmp(name, "a440"))
-      G_tuning_fork = TUNING_FORK_A440;
+      ctx->tuning_fork = TUNING_FORK_A440;
     else if (!strcmp(name, "a432"))
-      G_tuning_fork = TUNING_FORK_A432;
+      ctx->tuning_fork = TUNING_FORK_A432;
     else if (!strcmp(name, "c256"))
-      G_tuning_fork = TUNING_FORK_C256;
+      ctx->tuning_fork = TUNING_FORK_C256;
     else if (!strcmp(name, "amiga"))
-      G_tuning_fork = TUNING_FORK_AMIGA;
+      ctx->tuning_fork = TUNING_FORK_AMIGA;
     else
     {
       printf("Invalid tuning fork specified. Defaulting to A440.\n");
-      G_tuning_fork = TUNING_FORK_A440;
+      ctx->tuning_fork = TUNING_FORK_A440;
     }
   }
 
@@ -1975,9 +2024,9 @@ short int parse_data_tree_load_string(char* name,
 }
 
 /*******************************************************************************
-** parse_data_tree_to_globals()
+** parse_data_tree_to_context()
 *******************************************************************************/
-short int parse_data_tree_to_globals(data_tree_node* root)
+short int parse_data_tree_to_context(idunno_context* ctx, data_tree_node* root)
 {
   data_tree_node*   current;
   int               current_type;
@@ -1988,7 +2037,7 @@ short int parse_data_tree_to_globals(data_tree_node* root)
   int               stack_size;
   int               stack_top;
 
-  if (root == NULL)
+  if ((ctx == NULL) || (root == NULL))
     return 1;
 
   /* setup stack */
@@ -2034,9 +2083,9 @@ short int parse_data_tree_to_globals(data_tree_node* root)
     /* process this node */
     if (current_type == DATA_TREE_NODE_TYPE_FIELD_MEASURE)
     {
-      G_sequencer.num_measures += 1;
+      ctx->seq.num_measures += 1;
 
-      if (G_sequencer.num_measures > SEQUENCER_MAX_MEASURES)
+      if (ctx->seq.num_measures > SEQUENCER_MAX_MEASURES)
       {
         printf("Too many sequencer measures defined.\n");
         goto houston;
@@ -2044,9 +2093,9 @@ short int parse_data_tree_to_globals(data_tree_node* root)
     }
     else if (current_type == DATA_TREE_NODE_TYPE_FIELD_STEP)
     {
-      G_sequencer.measures[G_sequencer.num_measures - 1].num_steps += 1;
+      ctx->seq.measures[ctx->seq.num_measures - 1].num_steps += 1;
 
-      if (G_sequencer.measures[G_sequencer.num_measures - 1].num_steps > SEQUENCER_MAX_STEPS)
+      if (ctx->seq.measures[ctx->seq.num_measures - 1].num_steps > SEQUENCER_MAX_STEPS)
       {
         printf("Too many pattern steps defined.\n");
         goto houston;
@@ -2054,12 +2103,12 @@ short int parse_data_tree_to_globals(data_tree_node* root)
     }
     else if (current_type == DATA_TREE_NODE_TYPE_VALUE_INTEGER)
     {
-      parse_data_tree_load_integer( strtol(current->value, NULL, 10),
+      parse_data_tree_load_integer( ctx, strtol(current->value, NULL, 10),
                                     parent_type, grand_type);
     }
     else if (current_type == DATA_TREE_NODE_TYPE_VALUE_STRING)
     {
-      parse_data_tree_load_string(current->value, parent_type, grand_type);
+      parse_data_tree_load_string(ctx, current->value, parent_type, grand_type);
     }
 
     /* go to next node */
@@ -2094,8 +2143,8 @@ short int parse_data_tree_to_globals(data_tree_node* root)
 
   /* error handling */
 houston:
-  synth_deinit(&G_synth);
-  sequencer_deinit(&G_sequencer);
+  synth_deinit(&ctx->syn);
+  sequencer_deinit(&ctx->seq);
 
   /* cleanup */
 cleanup:
@@ -5,6 +5,7 @@
 #ifndef PARSE_H
 #define PARSE_H
 
+#include "context.h"
 #include "datatree.h"
 
 enum
@@ -16,6 +17,7 @@ enum
 
 /* function declarations */
 data_tree_node* parse_file_to_data_tree(char* filename);
-short int       parse_data_tree_to_globals(data_tree_node* root);
+data_tree_node* parse_memory_to_data_tree(char* buffer, int size);
+short int       parse_data_tree_to_context(idunno_context* ctx, data_tree_node* root);
 
 #endif
@@ -4,8 +4,105 @@
 
 #include <stdlib.h>
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define REVERB_X86_SIMD
+#include <immintrin.h>
+#endif
+
 #include "reverb.h"
 
+/* the delay is given in units of 512 samples */
+#define REVERB_DELAY_UNIT 512
+#define REVERB_MAX_DELAY  63
+
+/*******************************************************************************
+** reverb_filter()
+*******************************************************************************/
+static void reverb_filter(int* window, char* c, int* level, int num_samples)
+{
+  int i;
+
+  /* 8 tap fir over the window of delayed samples */
+  for (i = 0; i < num_samples; i++)
+  {
+    level[i] =  ((window[i + 0] * c[0]) / 128) + 
+                ((window[i + 1] * c[1]) / 128) + 
+                ((window[i + 2] * c[2]) / 128) + 
+                ((window[i + 3] * c[3]) / 128) + 
+                ((window[i + 4] * c[4]) / 128) + 
+                ((window[i + 5] * c[5]) / 128) + 
+                ((window[i + 6] * c[6]) / 128) + 
+                ((window[i + 7] * c[7]) / 128);
+  }
+}
+
+/* fir kernel (the scalar version is used until the kernels are selected) */
+static void (*S_reverb_filter)( int* window, char* c, 
+                                int* level, int num_samples) = reverb_filter;
+
+#ifdef REVERB_X86_SIMD
+/*******************************************************************************
+** reverb_filter_avx2()
+*******************************************************************************/
+__attribute__((target("avx2")))
+static void reverb_filter_avx2(int* window, char* c, int* level, int num_samples)
+{
+  int i;
+  int j;
+
+  __m256i coefficient[REVERB_NUM_TAPS];
+  __m256i round;
+  __m256i product;
+  __m256i sum;
+
+  for (j = 0; j < REVERB_NUM_TAPS; j++)
+    coefficient[j] = _mm256_set1_epi32(c[j]);
+
+  round = _mm256_set1_epi32(127);
+
+  /* eight outputs at a time; each product is divided by 128 */
+  /* rounding towards zero, as in the scalar version         */
+  for (i = 0; i + 8 <= num_samples; i += 8)
+  {
+    sum = _mm256_setzero_si256();
+
+    for (j = 0; j < REVERB_NUM_TAPS; j++)
+    {
+      product = _mm256_mullo_epi32( _mm256_loadu_si256((__m256i*) &window[i + j]), 
+                                    coefficient[j]);
+      product = _mm256_add_epi32( product, 
+                                  _mm256_and_si256( _mm256_srai_epi32(product, 31), 
+                                                    round));
+
+      sum = _mm256_add_epi32(sum, _mm256_srai_epi32(product, 7));
+    }
+
+    _mm256_storeu_si256((__m256i*) &level[i], sum);
+  }
+
+  /* remaining outputs */
+  reverb_filter(&window[i], c, &level[i], num_samples - i);
+}
+#endif
+
+/*******************************************************************************
+** reverb_select_kernels()
+*******************************************************************************/
+short int reverb_select_kernels()
+{
+  /* choose the fir kernel for this processor */
+  S_reverb_filter = reverb_filter;
+
+#ifdef REVERB_X86_SIMD
+  __builtin_cpu_init();
+
+  if (__builtin_cpu_supports("avx2"))
+    S_reverb_filter = reverb_filter_avx2;
+#endif
+
+  return 0;
+}
+
 /*******************************************************************************
 ** reverb_init()
 *******************************************************************************/
@@ -16,17 +113,23 @@ short int reverb_init(reverb* r)
   if (r == NULL)
     return 1;
 
+  r->mode = REVERB_MODE_BYPASS;
+
   for (i = 0; i < 8; i++)
     r->c[i] = 0;
 
   r->feedback = 0;
 
-  for (i = 0; i < 512 * 64; i++)
-    r->ring_buffer[i] = 0;
+  r->tap = 0;
 
+  r->ring_buffer  = NULL;
+  r->ring_mask    = 0;
   r->write_index  = 0;
   r->read_index   = 0;
 
+  r->delay          = 0;
+  r->silent_samples = 0;
+
   for (i = 0; i < 8; i++)
     r->x[i] = 0;
 
@@ -61,6 +164,14 @@ short int reverb_deinit(reverb* r)
   if (r == NULL)
     return 1;
 
+  if (r->ring_buffer != NULL)
+  {
+    free(r->ring_buffer);
+    r->ring_buffer = NULL;
+  }
+
+  r->ring_mask = 0;
+
   return 0;
 }
 
@@ -88,34 +199,26 @@ short int reverb_setup(reverb* r, char delay,
 {
   int i;
 
+  int num_taps;
+  int size;
+
   if (r == NULL)
     return 1;
 
-  /* clear buffers */
-  for (i = 0; i < 512 * 64; i++)
-    r->ring_buffer[i] = 0;
-
-  for (i = 0; i < 8; i++)
-    r->x[i] = 0;
-
-  for (i = 0; i < 2; i++)
-    r->y[i] = 0;
-
-  /* determine starting read index */
-  if ((delay < 0) || (delay > 63))
-    r->read_index = 0;
-  else if (delay == 0)
-    r->read_index = 0;
-  else
-    r->read_index = (64 - delay) * 512;
-
-  /* set starting write index */
-  r->write_index = 0;
-
   /* set coefficients */
-  for (i = 0; i < 8; i++)
+  num_taps = 0;
+
+  for (i = 0; i < REVERB_NUM_TAPS; i++)
+  {
     r->c[i] = c[i];
 
+    if (c[i] != 0)
+    {
+      r->tap = i;
+      num_taps += 1;
+    }
+  }
+
   /* set feedback */
   r->feedback = feedback;
 
@@ -125,54 +228,169 @@ short int reverb_setup(reverb* r, char delay,
   else
     r->volume = vol;
 
-  /* set level */
+  /* clear output window, set level */
+  for (i = 0; i < 2; i++)
+    r->y[i] = 0;
+
   r->level = 0;
 
+  /* without volume or taps the reverb adds nothing (the feedback only */
+  /* recirculates its own output); with one tap it is a plain delay    */
+  if ((r->volume == 0) || (num_taps == 0))
+  {
+    r->mode = REVERB_MODE_BYPASS;
+    return 0;
+  }
+  else if ((num_taps == 1) && (r->feedback == 0))
+    r->mode = REVERB_MODE_DELAY;
+  else
+    r->mode = REVERB_MODE_FIR;
+
+  /* determine delay */
+  if ((delay < 0) || (delay > REVERB_MAX_DELAY))
+    r->delay = 0;
+  else
+    r->delay = delay * REVERB_DELAY_UNIT;
+
+  /* size the echo buffer so that a block can be written before the */
+  /* delayed samples are read without overwriting any of them      */
+  size = 1;
+
+  while (size < r->delay + REVERB_BLOCK_SIZE)
+    size *= 2;
+
+  if (size != r->ring_mask + 1)
+  {
+    if (r->ring_buffer != NULL)
+      free(r->ring_buffer);
+
+    r->ring_buffer = malloc(size * sizeof(int));
+    r->ring_mask = 0;
+
+    if (r->ring_buffer == NULL)
+      return 1;
+
+    r->ring_mask = size - 1;
+  }
+
+  /* clear buffers */
+  for (i = 0; i < size; i++)
+    r->ring_buffer[i] = 0;
+
+  for (i = 0; i < REVERB_NUM_TAPS; i++)
+    r->x[i] = 0;
+
+  /* set starting indices (the read index trails by the delay) */
+  r->write_index = 0;
+  r->read_index = (size - r->delay) & r->ring_mask;
+
+  /* the engine starts out silent */
+  r->silent_samples = r->delay + REVERB_NUM_TAPS;
+
   return 0;
 }
 
 /*******************************************************************************
-** reverb_update()
+** reverb_process_block()
 *******************************************************************************/
-short int reverb_update(reverb* r, int input)
+short int reverb_process_block(reverb* r, int* buffer, int num_samples)
 {
   int i;
+  int k;
+  int m;
+
+  int window[REVERB_NUM_TAPS - 1 + REVERB_BLOCK_SIZE];
+  int level[REVERB_BLOCK_SIZE];
 
   if (r == NULL)
     return 1;
 
-  /* shift input window                     */
-  /* note that index 0 is the oldest sample */
-  for (i = 0; i < 7; i++)
-    r->x[i] = r->x[i + 1];
+  /* the reverb is inaudible */
+  if (r->mode == REVERB_MODE_BYPASS)
+  {
+    if (num_samples > 0)
+      r->level = buffer[num_samples - 1];
 
-  /* update ring buffer */
-  r->ring_buffer[r->write_index] = input;
+    return 0;
+  }
 
-  /* use (possibly) delayed input as next input to the window */
-  r->x[7] = r->ring_buffer[r->read_index];
-
-  /* shift output window */
-  r->y[0] = r->y[1];
-
-  /* compute level */
-  r->y[1] = ((r->x[0] * r->c[0]) / 128) + 
-            ((r->x[1] * r->c[1]) / 128) + 
-            ((r->x[2] * r->c[2]) / 128) + 
-            ((r->x[3] * r->c[3]) / 128) + 
-            ((r->x[4] * r->c[4]) / 128) + 
-            ((r->x[5] * r->c[5]) / 128) + 
-            ((r->x[6] * r->c[6]) / 128) + 
-            ((r->x[7] * r->c[7]) / 128) + 
-            ((r->y[0] * r->feedback) / 128);
-
-  /* set output level */
-  r->level = input + ((r->y[1] * r->volume) / 128);
+  if (r->ring_buffer == NULL)
+    return 1;
 
-  /* update ring buffer indices */
-  r->write_index = (r->write_index + 1) % (512 * 64);
-  r->read_index = (r->read_index + 1) % (512 * 64);
+  /* the samples are processed in pieces that fit the echo buffer margin */
+  for (k = 0; k < num_samples; k += m)
+  {
+    m = num_samples - k;
+
+    if (m > REVERB_BLOCK_SIZE)
+      m = REVERB_BLOCK_SIZE;
+
+    /* once the tail has decayed, the buffer holds silence for the whole */
+    /* delay, and a silent piece leaves the engine (and output) as is    */
+    if ((r->silent_samples >= r->delay + REVERB_NUM_TAPS) && (r->y[1] == 0))
+    {
+      for (i = 0; i < m; i++)
+      {
+        if (buffer[k + i] != 0)
+          break;
+      }
+
+      if (i == m)
+        continue;
+    }
+
+    /* update ring buffer */
+    for (i = 0; i < m; i++)
+    {
+      r->ring_buffer[(r->write_index + i) & r->ring_mask] = buffer[k + i];
+
+      /* count silent samples (stopping at the idle threshold) */
+      if (buffer[k + i] != 0)
+        r->silent_samples = 0;
+      else if (r->silent_samples < r->delay + REVERB_NUM_TAPS)
+        r->silent_samples += 1;
+    }
+
+    /* input window: the last 7 delayed samples, then this piece's */
+    /* note that index 0 is the oldest sample                      */
+    for (i = 0; i < REVERB_NUM_TAPS - 1; i++)
+      window[i] = r->x[i + 1];
+
+    for (i = 0; i < m; i++)
+    {
+      window[REVERB_NUM_TAPS - 1 + i] = 
+        r->ring_buffer[(r->read_index + i) & r->ring_mask];
+    }
+
+    for (i = 0; i < REVERB_NUM_TAPS; i++)
+      r->x[i] = window[m - 1 + i];
+
+    /* update ring buffer indices */
+    r->write_index = (r->write_index + m) & r->ring_mask;
+    r->read_index = (r->read_index + m) & r->ring_mask;
+
+    /* compute fir level (a plain delay only uses one tap) */
+    if (r->mode == REVERB_MODE_DELAY)
+    {
+      for (i = 0; i < m; i++)
+        level[i] = (window[i + r->tap] * r->c[r->tap]) / 128;
+    }
+    else
+      S_reverb_filter(window, r->c, level, m);
+
+    /* add feedback, and set output level */
+    for (i = 0; i < m; i++)
+    {
+      /* shift output window */
+      r->y[0] = r->y[1];
+      r->y[1] = level[i] + ((r->y[0] * r->feedback) / 128);
+
+      buffer[k + i] += (r->y[1] * r->volume) / 128;
+    }
+  }
+
+  if (num_samples > 0)
+    r->level = buffer[num_samples - 1];
 
   return 0;
 }
-
@@ -5,15 +5,39 @@
 #ifndef REVERB_H
 #define REVERB_H
 
+#define REVERB_NUM_TAPS   8
+#define REVERB_BLOCK_SIZE 256
+
+enum
+{
+  REVERB_MODE_BYPASS,
+  REVERB_MODE_DELAY,
+  REVERB_MODE_FIR
+};
+
 typedef struct reverb
 {
-  char  c[8];
+  /* bypass (inaudible), delay (one tap & no feedback) or full fir */
+  int   mode;
+
+  char  c[REVERB_NUM_TAPS];
   char  feedback;
 
-  int   ring_buffer[512 * 64];
+  /* tap used in delay mode */
+  int   tap;
+
+  /* echo buffer; its size is a power of two that holds the delay */
+  /* and a block, so the indices wrap with a mask                 */
+  int*  ring_buffer;
+  int   ring_mask;
   int   write_index;
   int   read_index;
 
+  /* delay, and the number of silent samples written in a row (the */
+  /* engine is skipped once its tail has decayed to silence)      */
+  int   delay;
+  int   silent_samples;
+
   int   x[8];
   int   y[2];
 
@@ -28,10 +52,12 @@ reverb*     reverb_create();
 short int   reverb_deinit(reverb* r);
 short int   reverb_destroy(reverb* r);
 
+short int   reverb_select_kernels();
+
 short int   reverb_setup(reverb* r, char delay, 
                                     char* c, 
                                     char feedback, 
                                     char vol);
-short int   reverb_update(reverb* r, int input);
+short int   reverb_process_block(reverb* r, int* buffer, int num_samples);
 
 #endif
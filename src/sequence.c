@@ -10,29 +10,11 @@
 #include "sequence.h"
 #include "synth.h"
 
-int G_sequencer_period_table[224];
-
-/* scale table */
-/* scales: 84 (12 scales, 7 modes per scale)            */
-/* tonics: 21 (C to B, each can also be sharp or flat)  */
-/* midi notes: 49 (7 per octave, and 7 octaves)         */
-static char S_scale_table[84][21][49];
-
-/* semitone jump pattern for each base scale (1st mode) */
-static char S_scale_semitone_jump_pattern[12][7] = 
-  { {2, 2, 1, 2, 2, 2, 1},  /* ionian           */
-    {2, 1, 2, 2, 2, 2, 1},  /* melodic minor    */
-    {2, 1, 2, 2, 1, 3, 1},  /* harmonic minor   */
-    {2, 2, 1, 2, 1, 3, 1},  /* harmonic major   */
-    {1, 3, 1, 2, 1, 3, 1},  /* double harmonic  */
-    {1, 2, 2, 2, 1, 3, 1},  /* neapolitan minor */
-    {1, 2, 2, 2, 2, 2, 1},  /* neapolitan major */
-    {3, 1, 2, 1, 2, 1, 2},  /* hungarian major  */
-    {1, 3, 2, 1, 2, 1, 2},  /* romanian major   */
-    {1, 3, 1, 1, 2, 3, 1},  /* persian          */
-    {1, 3, 2, 2, 2, 1, 1},  /* enigmatic        */
-    {1, 1, 3, 2, 1, 1, 3}   /* kanakangi        */
-  };
+/* sequencer period table and scale table (generated by tabgen) */
+/* scales: 84 (12 scales, 7 modes per scale)                     */
+/* tonics: 21 (C to B, each can also be sharp or flat)           */
+/* midi notes: 49 (7 per octave, and 7 octaves)                  */
+#include "sequence_tables.h"
 
 /*******************************************************************************
 ** step_init()
@@ -592,8 +574,8 @@ short int sequencer_activate_step(sequencer* seq, synth* syn)
   /* set volume */
   seq->volume = st->volume;
 
-  /* key off on all voices */
-  for (i = 0; i < SYNTH_MAX_VOICES; i++)
+  /* key off on all channels (the released voices keep sounding) */
+  for (i = 0; i < SYNTH_MAX_CHANNELS; i++)
     synth_key_off(syn, i);
 
   /* play initial note(s) */
@@ -756,7 +738,7 @@ short int sequencer_ahead_one_tick(sequencer* seq, synth* syn)
       }
       else
       {
-        for (i = 0; i < SYNTH_MAX_VOICES; i++)
+        for (i = 0; i < SYNTH_MAX_CHANNELS; i++)
           synth_key_off(syn, i);
 
         synth_key_on(syn, seq->arp_index, 
@@ -769,10 +751,33 @@ short int sequencer_ahead_one_tick(sequencer* seq, synth* syn)
   return 0;
 }
 
+/*******************************************************************************
+** sequencer_event_on_next_tick()
+*******************************************************************************/
+short int sequencer_event_on_next_tick(sequencer* seq)
+{
+  if (seq == NULL)
+    return 0;
+
+  /* if all measures played, no more events will be sent */
+  if ((seq->measure_index < 0) || (seq->measure_index >= seq->num_measures))
+    return 0;
+
+  /* the next tick moves to the next step */
+  if (seq->step_cycles <= 1)
+    return 1;
+
+  /* the next tick advances the arpeggiator */
+  if ((seq->arp_flags & SEQUENCER_ARPEGGIATOR_FLAG_ON) && (seq->arp_cycles <= 1))
+    return 1;
+
+  return 0;
+}
+
 /*******************************************************************************
 ** sequencer_calculate_length()
 *******************************************************************************/
-float sequencer_calculate_length(sequencer* seq)
+float sequencer_calculate_length(sequencer* seq, int bpm)
 {
   int       i;
   int       j;
@@ -842,99 +847,9 @@ float sequencer_calculate_length(sequencer* seq)
   }
 
   /* compute tick period (in seconds) */
-  delta_t = 60.0f / (G_bpm * SEQUENCER_TICKS_PER_QUARTER_NOTE);
+  delta_t = 60.0f / (bpm * SEQUENCER_TICKS_PER_QUARTER_NOTE);
 
   /* return length of sequence (in seconds) */
   return (total_ticks * delta_t);
 }
 
-/*******************************************************************************
-** sequencer_generate_tables()
-*******************************************************************************/
-short int sequencer_generate_tables()
-{
-  int   i;
-  int   j;
-  int   k;
-  float val;
-
-  /* sequencer period table */
-  for (i = 0; i < 224; i++)
-  {
-    val = 60.0f / ((i + 32) * SEQUENCER_TICKS_PER_QUARTER_NOTE);
-
-    G_sequencer_period_table[i] = (int) ((val * 1000000000) + 0.5f);
-  }
-
-  /* scale table */
-
-  /* set tonic notes in octave 4 */
-  for (i = 0; i < 84; i++)
-  {
-    S_scale_table[i][0][21]   = 60; /* C  */
-    S_scale_table[i][1][21]   = 61; /* C# */
-    S_scale_table[i][2][21]   = 59; /* Cb */
-
-    S_scale_table[i][3][22]   = 62; /* D  */
-    S_scale_table[i][4][22]   = 63; /* D# */
-    S_scale_table[i][5][22]   = 61; /* Db */
-
-    S_scale_table[i][6][23]   = 64; /* E  */
-    S_scale_table[i][7][23]   = 65; /* E# */
-    S_scale_table[i][8][23]   = 63; /* Eb */
-
-    S_scale_table[i][9][24]   = 65; /* F  */
-    S_scale_table[i][10][24]  = 66; /* F# */
-    S_scale_table[i][11][24]  = 64; /* Fb */
-
-    S_scale_table[i][12][25]  = 67; /* G  */
-    S_scale_table[i][13][25]  = 68; /* G# */
-    S_scale_table[i][14][25]  = 66; /* Gb */
-
-    S_scale_table[i][15][26]  = 69; /* A  */
-    S_scale_table[i][16][26]  = 70; /* A# */
-    S_scale_table[i][17][26]  = 68; /* Ab */
-
-    S_scale_table[i][18][27]  = 71; /* B  */
-    S_scale_table[i][19][27]  = 72; /* B# */
-    S_scale_table[i][20][27]  = 70; /* Bb */
-  }
-
-  /* generate one octave of each scale from the tonic */
-  for (i = 0; i < 84; i++)
-  {
-    for (j = 0; j < 21; j++)
-    {
-      for (k = 0; k < 7; k++)
-      {
-        S_scale_table[i][j][k + (j / 3) + 21 + 1] = 
-          S_scale_table[i][j][k + (j / 3) + 21] + S_scale_semitone_jump_pattern[i / 7][(k + i) % 7];
-      }
-    }
-  }
-
-  /* compute rest of each scale in the other octaves */
-  for (i = 0; i < 84; i++)
-  {
-    for (j = 0; j < 21; j++)
-    {
-      for (k = 0; k < 7; k++)
-      {
-        if (-7 + (j / 3) + k >= 0)
-          S_scale_table[i][j][-7 + (j / 3) + k] = S_scale_table[i][j][21 + (j / 3) + k] - 48;
-
-        S_scale_table[i][j][ 0 + (j / 3) + k] = S_scale_table[i][j][21 + (j / 3) + k] - 36;
-        S_scale_table[i][j][ 7 + (j / 3) + k] = S_scale_table[i][j][21 + (j / 3) + k] - 24;
-        S_scale_table[i][j][14 + (j / 3) + k] = S_scale_table[i][j][21 + (j / 3) + k] - 12;
-
-        S_scale_table[i][j][28 + (j / 3) + k] = S_scale_table[i][j][21 + (j / 3) + k] + 12;
-        S_scale_table[i][j][35 + (j / 3) + k] = S_scale_table[i][j][21 + (j / 3) + k] + 24;
-
-        if (42 + (j / 3) + k <= 49)
-          S_scale_table[i][j][42 + (j / 3) + k] = S_scale_table[i][j][21 + (j / 3) + k] + 36;
-      }
-    }
-  }
-
-  return 0;
-}
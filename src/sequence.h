@@ -206,7 +206,7 @@ typedef struct sequencer
   char    volume;
 } sequencer;
 
-extern int  G_sequencer_period_table[];
+extern const int G_sequencer_period_table[];
 
 /* function declarations */
 short int   sequencer_init(sequencer* seq);
@@ -218,9 +218,8 @@ short int   sequencer_reset(sequencer* seq);
 
 short int   sequencer_activate_step(sequencer* seq, synth* syn);
 short int   sequencer_ahead_one_tick(sequencer* seq, synth* syn);
+short int   sequencer_event_on_next_tick(sequencer* seq);
 
-float       sequencer_calculate_length(sequencer* seq);
-
-short int   sequencer_generate_tables();
+float       sequencer_calculate_length(sequencer* seq, int bpm);
 
 #endif
@@ -0,0 +1,404 @@
+/*******************************************************************************
+** server.c (render server)
+*******************************************************************************/
+
+/*******************************************************************************
+** The server reads render jobs from a stream, one after another. Each job is
+** a command line followed by the song text:
+**
+**   render <song size in bytes> [wav|pcm]
+**   <song text>
+**
+** The reply is a status line followed by the rendered data:
+**
+**   ok <data size in bytes> frames=... sampling=... bitres=...
+**      parse_ms=... render_ms=... rtf=...
+**   <data>
+**
+** or a single line "error <message>". The pcm data is the wav data chunk
+** without the header. A "quit" command ends the stream.
+*******************************************************************************/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "context.h"
+#include "export.h"
+#include "server.h"
+
+/*******************************************************************************
+** server_get_time()
+*******************************************************************************/
+static double server_get_time()
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+/*******************************************************************************
+** server_render_job()
+*******************************************************************************/
+static short int server_render_job( idunno_context* ctx,
+                                    char* song, int song_size,
+                                    int format, FILE* out)
+{
+  exporter  ex;
+
+  char*     data;
+  size_t    data_size;
+  size_t    data_offset;
+
+  short int buffer[SERVER_BUFFER_SIZE];
+  int       num_frames;
+  int       total_frames;
+
+  double    start_time;
+  double    parse_time;
+  double    render_time;
+  double    realtime_factor;
+
+  short int result;
+
+  /* initialization */
+  result = 1;
+
+  data = NULL;
+  data_size = 0;
+
+  exporter_init(&ex);
+
+  /* load the song; this includes regenerating any song dependent tables */
+  start_time = server_get_time();
+
+  if (idunno_context_load_memory(ctx, song, song_size))
+  {
+    fprintf(out, "error song not loaded\n");
+    goto cleanup;
+  }
+
+  parse_time = server_get_time() - start_time;
+
+  /* render the song to memory */
+  start_time = server_get_time();
+
+  if (exporter_open_memory(&ex, &data, &data_size))
+  {
+    fprintf(out, "error output buffer not opened\n");
+    goto cleanup;
+  }
+
+  if (exporter_write_header(&ex, ctx->export_sampling, ctx->export_bitres))
+  {
+    fprintf(out, "error invalid export settings\n");
+    goto cleanup;
+  }
+
+  total_frames = 0;
+
+  do
+  {
+    num_frames = idunno_context_render(ctx, buffer, SERVER_BUFFER_SIZE);
+
+    if (num_frames > 0)
+    {
+      if (exporter_write_block(&ex, buffer, num_frames))
+      {
+        fprintf(out, "error output not written\n");
+        goto cleanup;
+      }
+    }
+
+    total_frames += num_frames;
+  } while (num_frames > 0);
+
+  if (num_frames < 0)
+  {
+    fprintf(out, "error song not rendered\n");
+    goto cleanup;
+  }
+
+  if (exporter_close_file(&ex))
+  {
+    fprintf(out, "error output not written\n");
+    goto cleanup;
+  }
+
+  render_time = server_get_time() - start_time;
+
+  /* the pcm data is everything after the header */
+  if ((format == SERVER_FORMAT_PCM) && (data_size >= EXPORTER_HEADER_SIZE))
+    data_offset = EXPORTER_HEADER_SIZE;
+  else
+    data_offset = 0;
+
+  /* realtime factor (seconds of audio per second of rendering) */
+  if (render_time > 0.0)
+    realtime_factor = total_frames / (ctx->export_sampling * render_time);
+  else
+    realtime_factor = 0.0;
+
+  /* send reply */
+  fprintf(out, "ok %lu frames=%d sampling=%d bitres=%d ",
+          (unsigned long) (data_size - data_offset),
+          total_frames, ctx->export_sampling, ctx->export_bitres);
+
+  fprintf(out, "parse_ms=%.3f render_ms=%.3f rtf=%.2f\n",
+          parse_time * 1000.0, render_time * 1000.0, realtime_factor);
+
+  fwrite(&data[data_offset], 1, data_size - data_offset, out);
+
+  result = 0;
+
+  /* cleanup */
+cleanup:
+  synth_stop_threads(&ctx->syn);
+  exporter_deinit(&ex);
+
+  if (data != NULL)
+  {
+    free(data);
+    data = NULL;
+  }
+
+  fflush(out);
+
+  return result;
+}
+
+/*******************************************************************************
+** server_serve_stream()
+*******************************************************************************/
+short int server_serve_stream(idunno_context* ctx, FILE* in, FILE* out)
+{
+  char  line[256];
+  char  command[16];
+  char  format_name[16];
+
+  char* song;
+  int   song_size;
+  int   format;
+
+  if ((ctx == NULL) || (in == NULL) || (out == NULL))
+    return 1;
+
+  while (fgets(line, sizeof(line), in) != NULL)
+  {
+    /* skip blank lines */
+    if (sscanf(line, "%15s", command) != 1)
+      continue;
+
+    /* quit */
+    if (!strcmp(command, "quit"))
+      break;
+    /* render */
+    else if (!strcmp(command, "render"))
+    {
+      strcpy(format_name, "wav");
+
+      if (sscanf(line, "%15s %d %15s", command, &song_size, format_name) < 2)
+      {
+        fprintf(out, "error expected song size\n");
+        fflush(out);
+        continue;
+      }
+
+      /* the song text cannot be skipped if its size is invalid */
+      if ((song_size <= 0) || (song_size > SERVER_MAX_SONG_SIZE))
+      {
+        fprintf(out, "error invalid song size\n");
+        fflush(out);
+        return 1;
+      }
+
+      if (!strcmp(format_name, "wav"))
+        format = SERVER_FORMAT_WAV;
+      else if (!strcmp(format_name, "pcm"))
+        format = SERVER_FORMAT_PCM;
+      else
+        format = -1;
+
+      /* read song text */
+      song = malloc(song_size);
+
+      if (song == NULL)
+      {
+        fprintf(out, "error song buffer not allocated\n");
+        fflush(out);
+        return 1;
+      }
+
+      if (fread(song, 1, song_size, in) != (size_t) song_size)
+      {
+        free(song);
+        return 1;
+      }
+
+      if (format == -1)
+      {
+        fprintf(out, "error unknown format %s\n", format_name);
+        fflush(out);
+      }
+      else
+        server_render_job(ctx, song, song_size, format, out);
+
+      free(song);
+    }
+    else
+    {
+      fprintf(out, "error unknown command %s\n", command);
+      fflush(out);
+    }
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** server_run_stdin()
+*******************************************************************************/
+short int server_run_stdin(idunno_context* ctx)
+{
+  FILE* out;
+  int   fd;
+
+  if (ctx == NULL)
+    return 1;
+
+  /* replies go to the original standard output, and the */
+  /* messages printed while rendering go to standard error */
+  fflush(stdout);
+
+  fd = dup(STDOUT_FILENO);
+
+  if (fd < 0)
+    return 1;
+
+  out = fdopen(fd, "wb");
+
+  if (out == NULL)
+  {
+    close(fd);
+    return 1;
+  }
+
+  dup2(STDERR_FILENO, STDOUT_FILENO);
+
+  server_serve_stream(ctx, stdin, out);
+
+  fclose(out);
+
+  return 0;
+}
+
+/*******************************************************************************
+** server_run_socket()
+*******************************************************************************/
+short int server_run_socket(idunno_context* ctx, char* path)
+{
+  struct sockaddr_un addr;
+  struct stat        st;
+
+  int   fd;
+  int   conn_fd;
+  int   out_fd;
+
+  FILE* in;
+  FILE* out;
+
+  if ((ctx == NULL) || (path == NULL))
+    return 1;
+
+  if (strlen(path) >= sizeof(addr.sun_path))
+  {
+    printf("Socket path %s is too long.\n", path);
+    return 1;
+  }
+
+  /* only a socket left over from a previous run may be replaced */
+  if ((lstat(path, &st) == 0) && !S_ISSOCK(st.st_mode))
+  {
+    printf("Socket path %s exists.\n", path);
+    return 1;
+  }
+
+  /* a client that disconnects early should not stop the server */
+  signal(SIGPIPE, SIG_IGN);
+
+  /* create socket */
+  fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+  if (fd < 0)
+  {
+    printf("Socket not created.\n");
+    return 1;
+  }
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path);
+
+  /* remove a socket left over from a previous run */
+  unlink(path);
+
+  if (bind(fd, (struct sockaddr*) &addr, sizeof(addr)) || listen(fd, 16))
+  {
+    printf("Socket %s not opened.\n", path);
+    close(fd);
+    return 1;
+  }
+
+  printf("Listening on %s.\n", path);
+  fflush(stdout);
+
+  /* serve one connection at a time; the tables stay resident */
+  while (1)
+  {
+    conn_fd = accept(fd, NULL, NULL);
+
+    if (conn_fd < 0)
+    {
+      if (errno == EINTR)
+        continue;
+
+      break;
+    }
+
+    out_fd = dup(conn_fd);
+
+    in = fdopen(conn_fd, "rb");
+    out = (out_fd >= 0) ? fdopen(out_fd, "wb") : NULL;
+
+    if ((in != NULL) && (out != NULL))
+      server_serve_stream(ctx, in, out);
+
+    if (in != NULL)
+      fclose(in);
+    else
+      close(conn_fd);
+
+    if (out != NULL)
+      fclose(out);
+    else if (out_fd >= 0)
+      close(out_fd);
+  }
+
+  close(fd);
+  unlink(path);
+
+  return 0;
+}
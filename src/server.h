@@ -0,0 +1,27 @@
+/*******************************************************************************
+** server.h (render server)
+*******************************************************************************/
+
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <stdio.h>
+
+#include "context.h"
+
+#define SERVER_MAX_SONG_SIZE  (1 << 20)
+#define SERVER_BUFFER_SIZE    1024
+
+enum
+{
+  SERVER_FORMAT_WAV = 0,
+  SERVER_FORMAT_PCM
+};
+
+/* function declarations */
+short int server_serve_stream(idunno_context* ctx, FILE* in, FILE* out);
+
+short int server_run_stdin(idunno_context* ctx);
+short int server_run_socket(idunno_context* ctx, char* path);
+
+#endif
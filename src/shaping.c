@@ -2,110 +2,201 @@
 ** shaping.c (waveshaping)
 *******************************************************************************/
 
-#include <math.h>
+#include <stdlib.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SHAPING_X86_SIMD
+#include <immintrin.h>
+#endif
 
 #include "shaping.h"
 
 /* hyperbolic tangent waveshaper table  */
 /* 13-bit index: 8192 entries           */
-int G_waveshaper_tanh_table[8192];
-
-#if 0
-/* inverse hyperbolic sine & its derivative tables  */
-/* 13-bit index: 8192 entries                       */
-int   G_waveshaper_sinh_inverse_table[8192];
-float G_waveshaper_sinh_inverse_derivative_table[8192];
-#endif
+/* (generated by tabgen)                */
+#include "shaping_tables.h"
 
 /*******************************************************************************
-** shaping_generate_tables()
+** shaping_soft_clip()
 *******************************************************************************/
-short int shaping_generate_tables()
+static void shaping_soft_clip(int* buffer, short int* out, int num_samples)
 {
-  int   i;
+  int i;
 
-  float val;
+  int level;
 
-  /* hyperbolic tangent                           */
-  /* note: if tanh x is multiplied by 1/tanh(1),  */
-  /* the interval [-1, 1] maps to [-1, 1]         */
-  /* also, 1/tanh(1) = 1.313035285499331f         */
-  for (i = 0; i < 8192; i++)
+  for (i = 0; i < num_samples; i++)
   {
-    val = 1.313035285499331f * tanhf(i / 8192.0f);
+    level = buffer[i];
+
+    if (level > 32767 - 2)
+      level = 32767;
+    else if (level < -32767 + 2)
+      level = -32767;
+    else if (level >= 0)
+      level = G_waveshaper_tanh_table[(level + 2) / 4];
+    else
+      level = -G_waveshaper_tanh_table[(-level + 2) / 4];
 
-    G_waveshaper_tanh_table[i] = 
-      (int) ((32767 * val) + 0.5f);
+    out[i] = (short int) level;
   }
+}
+
+/*******************************************************************************
+** shaping_hard_clip()
+*******************************************************************************/
+static void shaping_hard_clip(int* buffer, short int* out, int num_samples)
+{
+  int i;
 
-#if 0
-  /* inverse hyperbolic sine                      */
-  /* note that sinh^-1(x) = ln(x + sqrt(x^2 + 1)) */
-  /* also, d/dx(sinh^-1(x)) = 1/sqrt(x^2 + 1)     */
-  for (i = 0; i < 8192; i++)
+  for (i = 0; i < num_samples; i++)
   {
-    val = i / 8192.0f;
+    if (buffer[i] > 32767)
+      out[i] = 32767;
+    else if (buffer[i] < -32767)
+      out[i] = -32767;
+    else
+      out[i] = (short int) buffer[i];
+  }
+}
 
-    val = log(val + sqrt((val * val) + 1));
+/* kernels (the scalar versions are used until the kernels are selected) */
+static void (*S_shaping_soft_clip)( int* buffer, short int* out, 
+                                    int num_samples) = shaping_soft_clip;
 
-    G_waveshaper_sinh_inverse_table[i] = 
-      (int) ((32767 * val) + 0.5f);
-  }
+static void (*S_shaping_hard_clip)( int* buffer, short int* out, 
+                                    int num_samples) = shaping_hard_clip;
 
-  /* inverse hyperbolic sine derivative */
-  for (i = 0; i < 8192; i++)
-  {
-    val = i / 8192.0f;
+#ifdef SHAPING_X86_SIMD
+/*******************************************************************************
+** shaping_pack_avx2()
+*******************************************************************************/
+__attribute__((target("avx2")))
+static void shaping_pack_avx2(short int* out, __m256i level)
+{
+  /* the levels are within 16 bits, so the saturating pack only narrows */
+  /* them; it works within each 128 bit lane, so the halves are joined  */
+  level = _mm256_packs_epi32(level, level);
+  level = _mm256_permute4x64_epi64(level, 0x08);
 
-    G_waveshaper_sinh_inverse_derivative_table[i] = 
-      1.0f / sqrt((val * val) + 1);
-  }
-#endif
+  _mm_storeu_si128((__m128i*) out, _mm256_castsi256_si128(level));
+}
 
-#if 0
-  printf("Hyperbolic Tangent Table:\n");
+/*******************************************************************************
+** shaping_soft_clip_avx2()
+*******************************************************************************/
+__attribute__((target("avx2")))
+static void shaping_soft_clip_avx2(int* buffer, short int* out, int num_samples)
+{
+  int i;
+
+  __m256i level;
+  __m256i magnitude;
+  __m256i index;
+  __m256i limit;
+  __m256i max_level;
 
-  for (i = 0; i < (8192 / 4); i++)
+  limit = _mm256_set1_epi32(32767 - 2);
+  max_level = _mm256_set1_epi32(32767);
+
+  /* eight samples at a time; the table is looked up with the magnitude */
+  /* (levels past the end of the table are set to the maximum level),   */
+  /* and the sign of the input is applied afterwards                    */
+  for (i = 0; i + 8 <= num_samples; i += 8)
   {
-    printf("%d %d %d %d\n", G_waveshaper_tanh_table[4 * i + 0], 
-                            G_waveshaper_tanh_table[4 * i + 1], 
-                            G_waveshaper_tanh_table[4 * i + 2], 
-                            G_waveshaper_tanh_table[4 * i + 3]);
+    level = _mm256_loadu_si256((__m256i*) &buffer[i]);
+
+    magnitude = _mm256_abs_epi32(level);
+
+    index = _mm256_min_epi32(magnitude, limit);
+    index = _mm256_srli_epi32(_mm256_add_epi32(index, _mm256_set1_epi32(2)), 2);
+
+    magnitude = _mm256_blendv_epi8(
+                  _mm256_i32gather_epi32(G_waveshaper_tanh_table, index, 4), 
+                  max_level, 
+                  _mm256_cmpgt_epi32(magnitude, limit));
+
+    shaping_pack_avx2(&out[i], _mm256_sign_epi32(magnitude, level));
   }
-#endif
 
-#if 0
-  printf("Inverse Hyperbolic Sine Table:\n");
+  /* remaining samples */
+  shaping_soft_clip(&buffer[i], &out[i], num_samples - i);
+}
+
+/*******************************************************************************
+** shaping_hard_clip_avx2()
+*******************************************************************************/
+__attribute__((target("avx2")))
+static void shaping_hard_clip_avx2(int* buffer, short int* out, int num_samples)
+{
+  int i;
 
-  for (i = 0; i < (8192 / 4); i++)
+  __m256i level;
+  __m256i max_level;
+  __m256i min_level;
+
+  max_level = _mm256_set1_epi32(32767);
+  min_level = _mm256_set1_epi32(-32767);
+
+  for (i = 0; i + 8 <= num_samples; i += 8)
   {
-    printf("%d %d %d %d\n", G_waveshaper_sinh_inverse_table[4 * i + 0], 
-                            G_waveshaper_sinh_inverse_table[4 * i + 1], 
-                            G_waveshaper_sinh_inverse_table[4 * i + 2], 
-                            G_waveshaper_sinh_inverse_table[4 * i + 3]);
+    level = _mm256_loadu_si256((__m256i*) &buffer[i]);
+
+    level = _mm256_min_epi32(level, max_level);
+    level = _mm256_max_epi32(level, min_level);
+
+    shaping_pack_avx2(&out[i], level);
   }
+
+  /* remaining samples */
+  shaping_hard_clip(&buffer[i], &out[i], num_samples - i);
+}
 #endif
 
-#if 0
-  int level;
+/*******************************************************************************
+** shaping_select_kernels()
+*******************************************************************************/
+short int shaping_select_kernels()
+{
+  /* choose the clipping kernels for this processor */
+  S_shaping_soft_clip = shaping_soft_clip;
+  S_shaping_hard_clip = shaping_hard_clip;
 
-  printf("Waveshaping Table Test:\n");
+#ifdef SHAPING_X86_SIMD
+  __builtin_cpu_init();
 
-  for (i = -32768; i < 32768; i++)
+  if (__builtin_cpu_supports("avx2"))
   {
-    if (i > 32767 - 2)
-      level = 32767;
-    else if (i < -32767 + 2)
-      level = -32767;
-    else if (i >= 0)
-      level = G_waveshaper_tanh_table[(i + 2) / 4];
-    else
-      level = -G_waveshaper_tanh_table[(-i + 2) / 4];
-
-    printf("Table Index: %d, Shaped Value: %d\n", i, level);
+    S_shaping_soft_clip = shaping_soft_clip_avx2;
+    S_shaping_hard_clip = shaping_hard_clip_avx2;
   }
 #endif
 
   return 0;
 }
 
+/*******************************************************************************
+** shaping_soft_clip_block()
+*******************************************************************************/
+short int shaping_soft_clip_block(int* buffer, short int* out, int num_samples)
+{
+  if ((buffer == NULL) || (out == NULL))
+    return 1;
+
+  S_shaping_soft_clip(buffer, out, num_samples);
+
+  return 0;
+}
+
+/*******************************************************************************
+** shaping_hard_clip_block()
+*******************************************************************************/
+short int shaping_hard_clip_block(int* buffer, short int* out, int num_samples)
+{
+  if ((buffer == NULL) || (out == NULL))
+    return 1;
+
+  S_shaping_hard_clip(buffer, out, num_samples);
+
+  return 0;
+}
@@ -5,14 +5,12 @@
 #ifndef SHAPING_H
 #define SHAPING_H
 
-extern int    G_waveshaper_tanh_table[];
-
-#if 0
-extern int    G_waveshaper_sinh_inverse_table[];
-extern float  G_waveshaper_sinh_inverse_derivative_table[];
-#endif
+extern const int G_waveshaper_tanh_table[];
 
 /* function declarations */
-short int shaping_generate_tables();
+short int shaping_select_kernels();
+
+short int shaping_soft_clip_block(int* buffer, short int* out, int num_samples);
+short int shaping_hard_clip_block(int* buffer, short int* out, int num_samples);
 
 #endif
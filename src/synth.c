@@ -2,8 +2,11 @@
 ** synth.c (individual synth)
 *******************************************************************************/
 
+#define _POSIX_C_SOURCE 200112L
+
 #include <stdlib.h>
 #include <math.h>
+#include <pthread.h>
 
 #include "clock.h"
 #include "envelope.h"
@@ -16,6 +19,132 @@
 #include "synth.h"
 #include "voice.h"
 
+typedef struct synth_worker
+{
+  synth*  s;
+  int     index;
+} synth_worker;
+
+typedef struct synth_threads
+{
+  pthread_t         thread[SYNTH_MAX_THREADS];
+  synth_worker      worker[SYNTH_MAX_THREADS];
+  int               num_threads;
+
+  /* the calling thread and the workers meet at the start */
+  /* and at the end of each block                         */
+  pthread_mutex_t   setup_mutex;
+  pthread_barrier_t start_barrier;
+  pthread_barrier_t end_barrier;
+
+  int               num_frames;
+  int               quit;
+} synth_threads;
+
+/*******************************************************************************
+** synth_render_voices()
+*******************************************************************************/
+static void synth_render_voices(synth* s, int index, int num_threads, int num_frames)
+{
+  int i;
+  int n;
+
+  /* each thread renders every num_threads-th active voice */
+  for (i = index; i < s->num_active; i += num_threads)
+  {
+    n = s->active_voice[i];
+    voice_render_block(&s->v[n], s->voice_buffer[n], num_frames);
+  }
+
+  return;
+}
+
+/*******************************************************************************
+** synth_allocate_voice()
+*******************************************************************************/
+static int synth_allocate_voice(synth* s)
+{
+  int i;
+  int n;
+
+  int attenuation;
+  int max_attenuation;
+
+  /* use the first idle voice */
+  for (i = 0; i < s->num_voices; i++)
+  {
+    if (s->v[i].state == VOICE_STATE_IDLE)
+      return i;
+  }
+
+  /* otherwise, steal the voice that was released first */
+  n = -1;
+
+  for (i = 0; i < s->num_voices; i++)
+  {
+    if (s->voice_channel[i] != -1)
+      continue;
+
+    if ((n == -1) || (s->voice_stamp[i] < s->voice_stamp[n]))
+      n = i;
+  }
+
+  if (n != -1)
+    return n;
+
+  /* otherwise, steal the quietest held voice (the oldest on a tie) */
+  max_attenuation = -1;
+
+  for (i = 0; i < s->num_voices; i++)
+  {
+    attenuation = s->v[i].env[0].attenuation + s->v[i].env[0].total_bound;
+
+    if ((attenuation > max_attenuation) || 
+        ((attenuation == max_attenuation) && 
+         (s->voice_stamp[i] < s->voice_stamp[n])))
+    {
+      max_attenuation = attenuation;
+      n = i;
+    }
+  }
+
+  /* the stolen voice no longer belongs to its channel */
+  s->channel_voice[s->voice_channel[n]] = -1;
+  s->voice_channel[n] = -1;
+
+  return n;
+}
+
+/*******************************************************************************
+** synth_worker_main()
+*******************************************************************************/
+static void* synth_worker_main(void* arg)
+{
+  synth_worker*   w;
+  synth_threads*  t;
+
+  w = (synth_worker*) arg;
+  t = w->s->threads;
+
+  /* wait until setup is complete */
+  pthread_mutex_lock(&t->setup_mutex);
+  pthread_mutex_unlock(&t->setup_mutex);
+
+  while (1)
+  {
+    pthread_barrier_wait(&t->start_barrier);
+
+    if (t->quit)
+      break;
+
+    synth_render_voices(w->s, w->index, t->num_threads, t->num_frames);
+
+    pthread_barrier_wait(&t->end_barrier);
+  }
+
+  return NULL;
+}
+
 /*******************************************************************************
 ** synth_init()
 *******************************************************************************/
@@ -33,6 +162,25 @@ short int synth_init(synth* s)
   for (i = 0; i < SYNTH_MAX_VOICES; i++)
     voice_init(&s->v[i]);
 
+  s->num_voices = SYNTH_DEFAULT_VOICES;
+
+  /* voice allocation */
+  for (i = 0; i < SYNTH_MAX_CHANNELS; i++)
+    s->channel_voice[i] = -1;
+
+  for (i = 0; i < SYNTH_MAX_VOICES; i++)
+  {
+    s->voice_channel[i] = -1;
+    s->voice_stamp[i] = 0;
+  }
+
+  s->stamp = 0;
+
+  s->num_active = 0;
+
+  /* worker threads */
+  s->threads = NULL;
+
   /* highpass filter */
   filter_init(&s->highpass);
 
@@ -68,6 +216,8 @@ short int synth_deinit(synth* s)
   if (s == NULL)
     return 1;
 
+  synth_stop_threads(s);
+
   patch_deinit(&s->p);
 
   for (i = 0; i < SYNTH_MAX_VOICES; i++)
@@ -97,20 +247,42 @@ short int synth_destroy(synth* s)
 /*******************************************************************************
 ** synth_setup()
 *******************************************************************************/
-short int synth_setup(synth* s)
+short int synth_setup(synth* s, tuning_tables* tuning)
 {
   int     i;
 
   patch*  p;
 
-  if (s == NULL)
+  if ((s == NULL) || (tuning == NULL))
     return 1;
 
   p = &s->p;
 
-  /* set patch pointer in each voice */
+  /* compile the patch into the voice render kernels */
+  if (voice_compile_program(&s->prog, p))
+    return 1;
+
+  /* set patch and table pointers in each voice, and start from silence */
   for (i = 0; i < SYNTH_MAX_VOICES; i++)
+  {
     s->v[i].p = &s->p;
+    s->v[i].prog = &s->prog;
+    s->v[i].tuning = tuning;
+    s->v[i].lowpass.tuning = tuning;
+
+    s->v[i].state = VOICE_STATE_IDLE;
+    filter_reset(&s->v[i].lowpass);
+
+    s->voice_channel[i] = -1;
+    s->voice_stamp[i] = 0;
+  }
+
+  for (i = 0; i < SYNTH_MAX_CHANNELS; i++)
+    s->channel_voice[i] = -1;
+
+  s->stamp = 0;
+
+  s->highpass.tuning = tuning;
 
   /* setup highpass filter                                            */
   /* settings: 0 is off, then 1-7 are D#1, A1, D#2, A2, D#3, A3, D#4  */
@@ -132,7 +304,8 @@ short int synth_setup(synth* s)
     filter_set_indices(&s->highpass, 21 * 32, 0);
 
   /* setup reverb */
-  reverb_setup(&s->r, p->rev_delay, p->rev_c, p->rev_feedback, p->rev_vol);
+  if (reverb_setup(&s->r, p->rev_delay, p->rev_c, p->rev_feedback, p->rev_vol))
+    return 1;
 
   /* reset output level */
   s->level = 0;
@@ -140,16 +313,166 @@ short int synth_setup(synth* s)
   return 0;
 }
 
+/*******************************************************************************
+** synth_set_polyphony()
+*******************************************************************************/
+short int synth_set_polyphony(synth* s, int num_voices)
+{
+  int i;
+
+  if (s == NULL)
+    return 1;
+
+  if ((num_voices < 1) || (num_voices > SYNTH_MAX_VOICES))
+    return 1;
+
+  /* silence the voices that are no longer in the pool */
+  for (i = num_voices; i < SYNTH_MAX_VOICES; i++)
+  {
+    if (s->voice_channel[i] != -1)
+      s->channel_voice[s->voice_channel[i]] = -1;
+
+    s->voice_channel[i] = -1;
+    s->v[i].state = VOICE_STATE_IDLE;
+    filter_reset(&s->v[i].lowpass);
+  }
+
+  s->num_voices = num_voices;
+
+  return 0;
+}
+
+/*******************************************************************************
+** synth_set_control_period()
+*******************************************************************************/
+short int synth_set_control_period(synth* s, int control_period)
+{
+  int i;
+
+  if (s == NULL)
+    return 1;
+
+  if ((control_period < 1) || (control_period > FILTER_MAX_CONTROL_PERIOD))
+    return 1;
+
+  /* set the rate at which the voice filter cutoffs are updated */
+  for (i = 0; i < SYNTH_MAX_VOICES; i++)
+    filter_set_control_period(&s->v[i].lowpass, control_period);
+
+  return 0;
+}
+
+/*******************************************************************************
+** synth_start_threads()
+*******************************************************************************/
+short int synth_start_threads(synth* s, int num_threads)
+{
+  int i;
+
+  synth_threads* t;
+
+  if (s == NULL)
+    return 1;
+
+  /* stop threads if they are currently running */
+  if (s->threads != NULL)
+    synth_stop_threads(s);
+
+  /* the calling thread counts as one of the threads */
+  if (num_threads > SYNTH_MAX_THREADS)
+    num_threads = SYNTH_MAX_THREADS;
+
+  if (num_threads <= 1)
+    return 0;
+
+  t = malloc(sizeof(synth_threads));
+
+  if (t == NULL)
+    return 1;
+
+  t->num_frames = 0;
+  t->quit = 0;
+
+  pthread_mutex_init(&t->setup_mutex, NULL);
+
+  s->threads = t;
+
+  /* start workers (the calling thread is worker 0); the workers */
+  /* wait on the setup mutex until the barriers are initialized  */
+  pthread_mutex_lock(&t->setup_mutex);
+
+  for (i = 1; i < num_threads; i++)
+  {
+    t->worker[i].s = s;
+    t->worker[i].index = i;
+
+    if (pthread_create(&t->thread[i], NULL, synth_worker_main, &t->worker[i]))
+      break;
+  }
+
+  t->num_threads = i;
+
+  pthread_barrier_init(&t->start_barrier, NULL, t->num_threads);
+  pthread_barrier_init(&t->end_barrier, NULL, t->num_threads);
+
+  pthread_mutex_unlock(&t->setup_mutex);
+
+  /* if no workers started, render on the calling thread only */
+  if (t->num_threads == 1)
+  {
+    synth_stop_threads(s);
+    return 1;
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** synth_stop_threads()
+*******************************************************************************/
+short int synth_stop_threads(synth* s)
+{
+  int i;
+
+  synth_threads* t;
+
+  if (s == NULL)
+    return 1;
+
+  if (s->threads == NULL)
+    return 0;
+
+  t = s->threads;
+
+  /* release the workers from the start barrier with the quit flag set */
+  t->quit = 1;
+  pthread_barrier_wait(&t->start_barrier);
+
+  for (i = 1; i < t->num_threads; i++)
+    pthread_join(t->thread[i], NULL);
+
+  pthread_barrier_destroy(&t->start_barrier);
+  pthread_barrier_destroy(&t->end_barrier);
+  pthread_mutex_destroy(&t->setup_mutex);
+
+  free(t);
+  s->threads = NULL;
+
+  return 0;
+}
+
 /*******************************************************************************
 ** synth_key_on()
 *******************************************************************************/
-short int synth_key_on(synth* s, int voice_num, char note, char vol)
+short int synth_key_on(synth* s, int channel, char note, char vol)
 {
+  int n;
+
   if (s == NULL)
     return 1;
 
-  /* if voice number is invalid, ignore */
-  if ((voice_num < 0) || (voice_num >= SYNTH_MAX_VOICES))
+  /* if channel is invalid, ignore */
+  if ((channel < 0) || (channel >= SYNTH_MAX_CHANNELS))
     return 0;
 
   /* if note is out of the range A0 to C8, ignore */
@@ -160,8 +483,23 @@ short int synth_key_on(synth* s, int voice_num, char note, char vol)
   if ((vol < 0) || (vol > 127))
     return 0;
 
+  /* a channel that is still held retriggers its voice; */
+  /* otherwise, a voice is allocated from the pool       */
+  n = s->channel_voice[channel];
+
+  if (n == -1)
+  {
+    n = synth_allocate_voice(s);
+
+    s->channel_voice[channel] = n;
+    s->voice_channel[n] = channel;
+  }
+
+  s->stamp += 1;
+  s->voice_stamp[n] = s->stamp;
+
   /* send key on command to voice */
-  voice_key_on(&s->v[voice_num], note, vol);
+  voice_key_on(&s->v[n], note, vol);
 
   return 0;
 }
@@ -169,87 +507,121 @@ short int synth_key_on(synth* s, int voice_num, char note, char vol)
 /*******************************************************************************
 ** synth_key_off()
 *******************************************************************************/
-short int synth_key_off(synth* s, int voice_num)
+short int synth_key_off(synth* s, int channel)
 {
+  int n;
+
   if (s == NULL)
     return 1;
 
-  /* if voice number is invalid, ignore */
-  if ((voice_num < 0) || (voice_num >= SYNTH_MAX_VOICES))
+  /* if channel is invalid, ignore */
+  if ((channel < 0) || (channel >= SYNTH_MAX_CHANNELS))
+    return 0;
+
+  /* if no voice is held by this channel, ignore */
+  n = s->channel_voice[channel];
+
+  if (n == -1)
     return 0;
 
+  /* the released voice keeps sounding until it goes idle */
+  s->channel_voice[channel] = -1;
+  s->voice_channel[n] = -1;
+
+  s->stamp += 1;
+  s->voice_stamp[n] = s->stamp;
+
   /* send key off command to voice */
-  voice_key_off(&s->v[voice_num]);
+  voice_key_off(&s->v[n]);
 
   return 0;
 }
 
 /*******************************************************************************
-** synth_update()
+** synth_render_block()
 *******************************************************************************/
-short int synth_update(synth* s)
+short int synth_render_block(synth* s, short int* buffer, int num_frames)
 {
   int     i;
+  int     j;
+  int     k;
+  int     m;
 
   patch*  p;
 
-  int     level;
+  int     out[SYNTH_BLOCK_SIZE];
+
+  synth_threads* t;
 
   if (s == NULL)
     return 1;
 
   p = &s->p;
+  t = s->threads;
 
-  /* update voices */
-  for (i = 0; i < SYNTH_MAX_VOICES; i++)
-    voice_update(&s->v[i]);
-
-  /* compute level */
-  level = 0;
-
-  for (i = 0; i < SYNTH_MAX_VOICES; i++)
-    level += s->v[i].level;
-
-  /* highpass filter */
-  if (p->hpf != 0)
+  /* the frames are processed in pieces that fit the voice buffer */
+  for (k = 0; k < num_frames; k += m)
   {
-    filter_update_highpass(&s->highpass, level);
+    m = num_frames - k;
+
+    if (m > SYNTH_BLOCK_SIZE)
+      m = SYNTH_BLOCK_SIZE;
+
+    /* determine which voices are rendered in this block */
+    /* (idle voices are silent, but their envelopes advance) */
+    s->num_active = 0;
+
+    for (i = 0; i < s->num_voices; i++)
+    {
+      if (s->v[i].state != VOICE_STATE_IDLE)
+      {
+        s->active_voice[s->num_active] = i;
+        s->num_active += 1;
+      }
+      else
+        voice_skip_block(&s->v[i], m);
+    }
+
+    /* update voices */
+    if (t != NULL)
+    {
+      t->num_frames = m;
+
+      pthread_barrier_wait(&t->start_barrier);
+      synth_render_voices(s, 0, t->num_threads, m);
+      pthread_barrier_wait(&t->end_barrier);
+    }
+    else
+      synth_render_voices(s, 0, 1, m);
 
-    level = s->highpass.level;
-  }
+    /* compute level (the voices are always mixed in the same order) */
+    for (j = 0; j < m; j++)
+      out[j] = 0;
 
-  /* reverb */
-  reverb_update(&s->r, level);
+    for (i = 0; i < s->num_active; i++)
+    {
+      for (j = 0; j < m; j++)
+        out[j] += s->voice_buffer[s->active_voice[i]][j];
+    }
 
-  level = s->r.level;
+    /* highpass filter */
+    if (p->hpf != 0)
+      filter_process_highpass_block(&s->highpass, out, m);
 
-  /* soft clipping */
-  if (p->soft_clip == 1)
-  {
-    if (level > 32767 - 2)
-      level = 32767;
-    else if (level < -32767 + 2)
-      level = -32767;
-    else if (level >= 0)
-      level = G_waveshaper_tanh_table[(level + 2) / 4];
+    /* reverb (it fails if its echo buffer was not allocated) */
+    if (reverb_process_block(&s->r, out, m))
+      return 1;
+
+    /* soft or hard clipping to the 16 bit output */
+    if (p->soft_clip == 1)
+      shaping_soft_clip_block(out, &buffer[k], m);
     else
-      level = -G_waveshaper_tanh_table[(-level + 2) / 4];
-  }
-  /* hard clipping */
-  else
-  {
-    if (level > 32767)
-      level = 32767;
-    else if (level < -32767)
-      level = -32767;
+      shaping_hard_clip_block(out, &buffer[k], m);
   }
 
-  /* apply master volume */
-  /*level = (level * s->volume) / 128;*/
-
-  /* set voice level */
-  s->level = level;
+  /* set output level */
+  if (num_frames > 0)
+    s->level = buffer[num_frames - 1];
 
   return 0;
 }
-
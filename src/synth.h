@@ -8,17 +8,47 @@
 #include "filter.h"
 #include "patch.h"
 #include "reverb.h"
+#include "tuning.h"
 #include "voice.h"
 
-#define SYNTH_MAX_VOICES 6
+#define SYNTH_MAX_VOICES      64
+#define SYNTH_DEFAULT_VOICES  16
+
+/* one channel per chord note; a channel holds at most one voice */
+#define SYNTH_MAX_CHANNELS    6
+
+#define SYNTH_BLOCK_SIZE VOICE_BLOCK_SIZE
+
+#define SYNTH_MAX_THREADS 8
+
+/* worker threads (defined in synth.c) */
+struct synth_threads;
 
 typedef struct synth
 {
-  /* patch */
-  patch   p;
+  /* patch, compiled patch */
+  patch         p;
+  voice_program prog;
 
-  /* voices */
+  /* voice pool (the first num_voices are used) */
   voice   v[SYNTH_MAX_VOICES];
+  int     num_voices;
+
+  /* voice allocation: the voice held by each channel, the channel    */
+  /* holding each voice (-1 if none), and the last key on/off stamps   */
+  int           channel_voice[SYNTH_MAX_CHANNELS];
+  int           voice_channel[SYNTH_MAX_VOICES];
+  unsigned long voice_stamp[SYNTH_MAX_VOICES];
+  unsigned long stamp;
+
+  /* voices rendered in the current block, and their output */
+  int     active_voice[SYNTH_MAX_VOICES];
+  int     num_active;
+
+  int     voice_buffer[SYNTH_MAX_VOICES][SYNTH_BLOCK_SIZE];
+
+  /* worker threads (null when rendering on the calling thread only) */
+  struct synth_threads* threads;
 
   /* highpass filter */
   filter  highpass;
@@ -36,9 +66,14 @@ synth*      synth_create();
 short int   synth_deinit(synth* s);
 short int   synth_destroy(synth* s);
 
-short int   synth_setup(synth* s);
-short int   synth_key_on(synth* s, int voice_num, char note, char volume);
-short int   synth_key_off(synth* s, int voice_num);
-short int   synth_update(synth* s);
+short int   synth_setup(synth* s, tuning_tables* tuning);
+short int   synth_set_polyphony(synth* s, int num_voices);
+short int   synth_set_control_period(synth* s, int control_period);
+short int   synth_start_threads(synth* s, int num_threads);
+short int   synth_stop_threads(synth* s);
+
+short int   synth_key_on(synth* s, int channel, char note, char volume);
+short int   synth_key_off(synth* s, int channel);
+short int   synth_render_block(synth* s, short int* buffer, int num_frames);
 
 #endif
@@ -22,8 +22,21 @@
   }
 
 #define TOKENIZER_UPDATE_NEXT_CHAR()                                           \
-  if (fread(&(t->nc), 1, 1, t->fp) == 0)                                       \
-    t->nc = 0;
+  if (t->fp != NULL)                                                           \
+  {                                                                            \
+    if (fread(&(t->nc), 1, 1, t->fp) == 0)                                     \
+    {                                                                          \
+      t->nc = 0;                                                               \
+      t->eof = 1;                                                              \
+    }                                                                          \
+  }                                                                            \
+  else if (t->mb_i < t->mb_size)                                               \
+    t->nc = t->mb[t->mb_i++];                                                  \
+  else                                                                         \
+  {                                                                            \
+    t->nc = 0;                                                                 \
+    t->eof = 1;                                                                \
+  }
 
 /*******************************************************************************
 ** tokenizer_init()
@@ -35,6 +48,12 @@ short int tokenizer_init(tokenizer* t)
 
   t->fp = NULL;
 
+  t->mb = NULL;
+  t->mb_size = 0;
+  t->mb_i = 0;
+
+  t->eof = 0;
+
   t->nc = 0;
   t->token = TOKEN_EOF;
   t->ln = 0;
@@ -67,7 +86,7 @@ short int tokenizer_deinit(tokenizer* t)
     return 1;
 
   /* close open file if necessary */
-  if (t->fp != NULL)
+  if ((t->fp != NULL) || (t->mb != NULL))
     tokenizer_close_file(t);
 
   t->nc = 0;
@@ -102,7 +121,7 @@ short int tokenizer_advance(tokenizer* t)
     return 1;
 
   /* check that stream exists */
-  if (t->fp == NULL)
+  if ((t->fp == NULL) && (t->mb == NULL))
   {
     t->token = TOKEN_ERROR;
     return 0;
@@ -130,7 +149,7 @@ short int tokenizer_advance(tokenizer* t)
         TOKENIZER_UPDATE_NEXT_CHAR()
 
         /* skip to end of block comment */
-        while (!feof(t->fp))
+        while (!t->eof)
         {
           if (t->nc == '*')
           {
@@ -269,7 +288,7 @@ short int tokenizer_advance(tokenizer* t)
     t->token = TOKEN_NUMBER_INTEGER;
   }
   /* eof */
-  else if (feof(t->fp))
+  else if (t->eof)
     t->token = TOKEN_EOF;
   /* error */
   else
@@ -287,7 +306,7 @@ short int tokenizer_open_file(tokenizer* t, char* filename)
     return 1;
 
   /* close file if one is currently open */
-  if (t->fp != NULL)
+  if ((t->fp != NULL) || (t->mb != NULL))
     tokenizer_close_file(t);
 
   /* open file */
@@ -301,6 +320,7 @@ short int tokenizer_open_file(tokenizer* t, char* filename)
   TOKENIZER_RESET_STRING_BUFFER()
 
   t->ln = 1;
+  t->eof = 0;
 
   /* get first token */
   TOKENIZER_UPDATE_NEXT_CHAR()
@@ -321,6 +341,45 @@ short int tokenizer_close_file(tokenizer* t)
     t->fp = NULL;
   }
 
+  /* the memory buffer belongs to the caller */
+  if ((t != NULL) && (t->mb != NULL))
+  {
+    t->mb = NULL;
+    t->mb_size = 0;
+    t->mb_i = 0;
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** tokenizer_open_memory()
+*******************************************************************************/
+short int tokenizer_open_memory(tokenizer* t, char* buffer, int size)
+{
+  if ((t == NULL) || (buffer == NULL) || (size < 0))
+    return 1;
+
+  /* close file if one is currently open */
+  if ((t->fp != NULL) || (t->mb != NULL))
+    tokenizer_close_file(t);
+
+  /* the buffer is read in place */
+  t->mb = buffer;
+  t->mb_size = size;
+  t->mb_i = 0;
+
+  /* reset string buffer and line number */
+  TOKENIZER_RESET_STRING_BUFFER()
+
+  t->ln = 1;
+  t->eof = 0;
+
+  /* get first token */
+  TOKENIZER_UPDATE_NEXT_CHAR()
+
+  tokenizer_advance(t);
+
   return 0;
 }
 
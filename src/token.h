@@ -31,6 +31,12 @@ typedef struct tokenizer
 {
   FILE* fp;                               /* file pointer */
 
+  char* mb;                               /* memory buffer */
+  int   mb_size;
+  int   mb_i;
+
+  int   eof;                              /* end of input reached */
+
   char  nc;                               /* next character */
   int   token;                            /* current token */
   int   ln;                               /* line number */
@@ -50,6 +56,8 @@ short int   tokenizer_advance(tokenizer* t);
 short int   tokenizer_open_file(tokenizer* t, char* filename);
 short int   tokenizer_close_file(tokenizer* t);
 
+short int   tokenizer_open_memory(tokenizer* t, char* buffer, int size);
+
 short int   tokenizer_print_file_tokens(tokenizer* t, char* filename);
 
 #endif
@@ -2,24 +2,17 @@
 ** tuning.c (tuning systems)
 *******************************************************************************/
 
+#define _ISOC99_SOURCE  /* tanf */
+
+#include <stdio.h>
 #include <math.h>
 
 #include "clock.h"
 #include "global.h"
 #include "tuning.h"
 
-/* frequency table  */
-float G_frequency_table[4096];
-
-/* phase increment table      */
-int   G_phase_increment_table[4096];
-
-/* filter coefficient tables  */
-float G_filter_omega_0_delta_t_over_2_table[4096];
-float G_filter_stage_multiplier_table[4096];
-
-/* filter resonance table */
-float G_resonance_table[32];
+/* filter resonance table (generated by tabgen) */
+#include "tuning_tables.h"
 
 /* multipliers from c in 12 tone equal temperament */
 static float S_tuning_mult_12_et[12] = 
@@ -157,9 +150,10 @@ static float S_tuning_mult_renold_i[12] =
           1.8984375};           /* 243:128        B  */
 
 /*******************************************************************************
-** tuning_generate_tables()
+** tuning_compute_tables()
 *******************************************************************************/
-short int tuning_generate_tables()
+short int tuning_compute_tables(tuning_tables* t, 
+                                int tuning_system, int tuning_fork)
 {
   int     i;
   int     j;
@@ -171,79 +165,82 @@ short int tuning_generate_tables()
 
   float   val;
 
+  if (t == NULL)
+    return 1;
+
   /* determine multiplier table */
-  if (G_tuning_system == TUNING_SYSTEM_12_ET)
+  if (tuning_system == TUNING_SYSTEM_12_ET)
     mult_table = S_tuning_mult_12_et;
-  else if (G_tuning_system == TUNING_SYSTEM_PYTHAGOREAN)
+  else if (tuning_system == TUNING_SYSTEM_PYTHAGOREAN)
     mult_table = S_tuning_mult_pythagorean;
-  else if (G_tuning_system == TUNING_SYSTEM_QC_MEANTONE)
+  else if (tuning_system == TUNING_SYSTEM_QC_MEANTONE)
     mult_table = S_tuning_mult_qc_meantone;
-  else if (G_tuning_system == TUNING_SYSTEM_JUST)
+  else if (tuning_system == TUNING_SYSTEM_JUST)
     mult_table = S_tuning_mult_just_intonation;
-  else if (G_tuning_system == TUNING_SYSTEM_WERCKMEISTER_III)
+  else if (tuning_system == TUNING_SYSTEM_WERCKMEISTER_III)
     mult_table = S_tuning_mult_werckmeister_iii;
-  else if (G_tuning_system == TUNING_SYSTEM_WERCKMEISTER_IV)
+  else if (tuning_system == TUNING_SYSTEM_WERCKMEISTER_IV)
     mult_table = S_tuning_mult_werckmeister_iv;
-  else if (G_tuning_system == TUNING_SYSTEM_WERCKMEISTER_V)
+  else if (tuning_system == TUNING_SYSTEM_WERCKMEISTER_V)
     mult_table = S_tuning_mult_werckmeister_v;
-  else if (G_tuning_system == TUNING_SYSTEM_WERCKMEISTER_VI)
+  else if (tuning_system == TUNING_SYSTEM_WERCKMEISTER_VI)
     mult_table = S_tuning_mult_werckmeister_vi;
-  else if (G_tuning_system == TUNING_SYSTEM_RENOLD_I)
+  else if (tuning_system == TUNING_SYSTEM_RENOLD_I)
     mult_table = S_tuning_mult_renold_i;
   else
     mult_table = S_tuning_mult_12_et;
 
   /* compute frequency at tuning fork */
-  if (G_tuning_fork == TUNING_FORK_C256)
-    G_frequency_table[60 * 32] = 256;
-  else if (G_tuning_fork == TUNING_FORK_A440)
-    G_frequency_table[69 * 32] = 440;
-  else if (G_tuning_fork == TUNING_FORK_A432)
-    G_frequency_table[69 * 32] = 432;
-  else if (G_tuning_fork == TUNING_FORK_AMIGA)
-    G_frequency_table[60 * 32] = 261.34375; /* 8363 / 32 */
+  if (tuning_fork == TUNING_FORK_C256)
+    t->frequency_table[60 * 32] = 256;
+  else if (tuning_fork == TUNING_FORK_A440)
+    t->frequency_table[69 * 32] = 440;
+  else if (tuning_fork == TUNING_FORK_A432)
+    t->frequency_table[69 * 32] = 432;
+  else if (tuning_fork == TUNING_FORK_AMIGA)
+    t->frequency_table[60 * 32] = 261.34375; /* 8363 / 32 */
   else
     return 1;
 
   /* compute frequencies for notes in octave 4 based on tuning system */
-  if ((G_tuning_fork == TUNING_FORK_C256) ||
-      (G_tuning_fork == TUNING_FORK_AMIGA))
+  if ((tuning_fork == TUNING_FORK_C256) ||
+      (tuning_fork == TUNING_FORK_AMIGA))
   {
     for (i = 1; i < 12; i++)
     {
-      G_frequency_table[(60 + i) * 32] = 
-        G_frequency_table[60 * 32] * mult_table[i];
+      t->frequency_table[(60 + i) * 32] = 
+        t->frequency_table[60 * 32] * mult_table[i];
     }
   }
-  else if ( (G_tuning_fork == TUNING_FORK_A440) ||
-            (G_tuning_fork == TUNING_FORK_A432))
+  else if ( (tuning_fork == TUNING_FORK_A440) ||
+            (tuning_fork == TUNING_FORK_A432))
   {
     for (i = 0; i < 12; i++)
     {
       if (i == 9)
         continue;
 
-      G_frequency_table[(60 + i) * 32] = 
-        G_frequency_table[69 * 32] * mult_table[i] / mult_table[9];
+      t->frequency_table[(60 + i) * 32] = 
+        t->frequency_table[69 * 32] * mult_table[i] / mult_table[9];
     }
   }
 
   /* compute frequencies at all notes */
   for (i = 0; i < 12; i++)
   {
-    G_frequency_table[( 0 + i) * 32] = G_frequency_table[(60 + i) * 32] / 32;
-    G_frequency_table[(12 + i) * 32] = G_frequency_table[(60 + i) * 32] / 16;
-    G_frequency_table[(24 + i) * 32] = G_frequency_table[(60 + i) * 32] / 8;
-    G_frequency_table[(36 + i) * 32] = G_frequency_table[(60 + i) * 32] / 4;
-    G_frequency_table[(48 + i) * 32] = G_frequency_table[(60 + i) * 32] / 2;
+    t->frequency_table[( 0 + i) * 32] = t->frequency_table[(60 + i) * 32] / 32;
+    t->frequency_table[(12 + i) * 32] = t->frequency_table[(60 + i) * 32] / 16;
+    t->frequency_table[(24 + i) * 32] = t->frequency_table[(60 + i) * 32] / 8;
+    t->frequency_table[(36 + i) * 32] = t->frequency_table[(60 + i) * 32] / 4;
+    t->frequency_table[(48 + i) * 32] = t->frequency_table[(60 + i) * 32] / 2;
 
-    G_frequency_table[( 72 + i) * 32] = G_frequency_table[(60 + i) * 32] * 2;
-    G_frequency_table[( 84 + i) * 32] = G_frequency_table[(60 + i) * 32] * 4;
-    G_frequency_table[( 96 + i) * 32] = G_frequency_table[(60 + i) * 32] * 8;
-    G_frequency_table[(108 + i) * 32] = G_frequency_table[(60 + i) * 32] * 16;
+    t->frequency_table[( 72 + i) * 32] = t->frequency_table[(60 + i) * 32] * 2;
+    t->frequency_table[( 84 + i) * 32] = t->frequency_table[(60 + i) * 32] * 4;
+    t->frequency_table[( 96 + i) * 32] = t->frequency_table[(60 + i) * 32] * 8;
+    t->frequency_table[(108 + i) * 32] = t->frequency_table[(60 + i) * 32] * 16;
 
     if (120 + i < 128)
-      G_frequency_table[(120 + i) * 32] = G_frequency_table[(60 + i) * 32] * 32;
+      t->frequency_table[(120 + i) * 32] = t->frequency_table[(60 + i) * 32] * 32;
   }
 
   /* compute frequencies between notes */
@@ -258,74 +255,64 @@ short int tuning_generate_tables()
 
     for (j = 1; j < 32; j++)
     {
-      G_frequency_table[32 * (60 + i) + j] = 
-        G_frequency_table[32 * 60] * exp(log(2) * ((cents + delta * j) / 1200.0f));
+      t->frequency_table[32 * (60 + i) + j] = 
+        t->frequency_table[32 * 60] * exp(log(2) * ((cents + delta * j) / 1200.0f));
 
-      G_frequency_table[32 * ( 0 + i) + j] = G_frequency_table[32 * (60 + i) + j] / 32.0f;
-      G_frequency_table[32 * (12 + i) + j] = G_frequency_table[32 * (60 + i) + j] / 16.0f;
-      G_frequency_table[32 * (24 + i) + j] = G_frequency_table[32 * (60 + i) + j] / 8.0f;
-      G_frequency_table[32 * (36 + i) + j] = G_frequency_table[32 * (60 + i) + j] / 4.0f;
-      G_frequency_table[32 * (48 + i) + j] = G_frequency_table[32 * (60 + i) + j] / 2.0f;
+      t->frequency_table[32 * ( 0 + i) + j] = t->frequency_table[32 * (60 + i) + j] / 32.0f;
+      t->frequency_table[32 * (12 + i) + j] = t->frequency_table[32 * (60 + i) + j] / 16.0f;
+      t->frequency_table[32 * (24 + i) + j] = t->frequency_table[32 * (60 + i) + j] / 8.0f;
+      t->frequency_table[32 * (36 + i) + j] = t->frequency_table[32 * (60 + i) + j] / 4.0f;
+      t->frequency_table[32 * (48 + i) + j] = t->frequency_table[32 * (60 + i) + j] / 2.0f;
 
-      G_frequency_table[32 * (72 + i) + j] = G_frequency_table[32 * (60 + i) + j] * 2.0f;
-      G_frequency_table[32 * (84 + i) + j] = G_frequency_table[32 * (60 + i) + j] * 4.0f;
-      G_frequency_table[32 * (96 + i) + j] = G_frequency_table[32 * (60 + i) + j] * 8.0f;
-      G_frequency_table[32 * (108 + i) + j] = G_frequency_table[32 * (60 + i) + j] * 16.0f;
+      t->frequency_table[32 * (72 + i) + j] = t->frequency_table[32 * (60 + i) + j] * 2.0f;
+      t->frequency_table[32 * (84 + i) + j] = t->frequency_table[32 * (60 + i) + j] * 4.0f;
+      t->frequency_table[32 * (96 + i) + j] = t->frequency_table[32 * (60 + i) + j] * 8.0f;
+      t->frequency_table[32 * (108 + i) + j] = t->frequency_table[32 * (60 + i) + j] * 16.0f;
 
       if (120 + i < 128)
-        G_frequency_table[32 * (120 + i) + j] = G_frequency_table[32 * (60 + i) + j] * 32.0f;
+        t->frequency_table[32 * (120 + i) + j] = t->frequency_table[32 * (60 + i) + j] * 32.0f;
     }
   }
 
-  /* compute resonance table */
-
-  /* see Vadim Zavalishin's "The Art of VA Filter Design"               */
-  /* The values in the table are for K, which is in the interval [0, 2) */
-  /* In Section 4.2, p. 103, there is a formula for R (the resonance    */
-  /* parameter for the SVF) based on the resonance peak height A:       */
-  /*   R = sqrt((1 - sqrt(1 - A^-2))/2)                                 */
-  /* Here, we are computing K values for the TSK filter. As shown in    */
-  /* Section 5.8, p. 152, we have 2R = 2 - K.                           */
-  /* So, plugging the first equation into the second, we obtain:        */
-  /*   K = 2 - sqrt(2[1 - sqrt(1 - A^-2)])                              */
-  for (i = 0; i < 32; i++)
-  {
-    val = exp(log(10) * i / 32.0f);
-
-    G_resonance_table[i] = 2 - sqrt(2 - (2 * sqrt(1 - (1 / (val * val)))));
-  }
-
   /* generate other tables */
   for (i = 0; i < 4096; i++)
   {
-    G_phase_increment_table[i] = 
-      (int) ((G_frequency_table[i] * GENESIS_1HZ_PHASE_INCREMENT) + 0.5);
+    t->phase_increment_table[i] = 
+      (int) ((t->frequency_table[i] * GENESIS_1HZ_PHASE_INCREMENT) + 0.5);
 
     /* see Vadim Zavalishin's "The Art of VA Filter Design" for equations */
 
     /* compute omega_0 */
-    val = TWO_PI * G_frequency_table[i];
+    val = TWO_PI * t->frequency_table[i];
 
     /* pre-warping (section 3.8, p. 62)                               */
     /* (1/2) * new_omega_0 * delta_T = tan((1/2) * omega_0 * delta_T) */
     val = tanf(0.5f * val * GENESIS_DELTA_T_SECONDS);
 
-    G_filter_omega_0_delta_t_over_2_table[i] = val;
+    t->filter_omega_0_delta_t_over_2_table[i] = val;
 
     /* 1st order stage multiplier calculation (section 3.10, p. 76-77)              */
     /* multiplier = ((1/2) * omega_0 * delta_T) / [1 + ((1/2) * omega_0 * delta_T)] */
-    G_filter_stage_multiplier_table[i] = val / (1.0f + val);
+    t->filter_stage_multiplier_table[i] = val / (1.0f + val);
+
+    t->filter_stage_multiplier_fixed_table[i] = 
+      (int) ((t->filter_stage_multiplier_table[i] * 
+              (1 << TUNING_FILTER_FIXED_BITS)) + 0.5f);
   }
 
+  /* store the settings that these tables were computed for */
+  t->tuning_system = tuning_system;
+  t->tuning_fork = tuning_fork;
+
 #if 0
   printf("Frequency Table:\n");
 
   for (i = 0; i < (4096 / 4); i++)
   {
-    printf("%f %f %f %f\n", G_frequency_table[4 * i + 0], 
-                            G_frequency_table[4 * i + 1], 
-                            G_frequency_table[4 * i + 2], 
-                            G_frequency_table[4 * i + 3]);
+    printf("%f %f %f %f\n", t->frequency_table[4 * i + 0], 
+                            t->frequency_table[4 * i + 1], 
+                            t->frequency_table[4 * i + 2], 
+                            t->frequency_table[4 * i + 3]);
   }
 #endif
 
@@ -334,10 +321,10 @@ short int tuning_generate_tables()
 
   for (i = 0; i < (4096 / 4); i++)
   {
-    printf("%d %d %d %d\n", G_phase_increment_table[4 * i + 0], 
-                            G_phase_increment_table[4 * i + 1], 
-                            G_phase_increment_table[4 * i + 2], 
-                            G_phase_increment_table[4 * i + 3]);
+    printf("%d %d %d %d\n", t->phase_increment_table[4 * i + 0], 
+                            t->phase_increment_table[4 * i + 1], 
+                            t->phase_increment_table[4 * i + 2], 
+                            t->phase_increment_table[4 * i + 3]);
   }
 #endif
 
@@ -346,10 +333,10 @@ short int tuning_generate_tables()
 
   for (i = 0; i < (4096 / 4); i++)
   {
-    printf("%f %f %f %f\n", G_filter_omega_0_delta_t_over_2_table[4 * i + 0], 
-                            G_filter_omega_0_delta_t_over_2_table[4 * i + 1], 
-                            G_filter_omega_0_delta_t_over_2_table[4 * i + 2], 
-                            G_filter_omega_0_delta_t_over_2_table[4 * i + 3]);
+    printf("%f %f %f %f\n", t->filter_omega_0_delta_t_over_2_table[4 * i + 0], 
+                            t->filter_omega_0_delta_t_over_2_table[4 * i + 1], 
+                            t->filter_omega_0_delta_t_over_2_table[4 * i + 2], 
+                            t->filter_omega_0_delta_t_over_2_table[4 * i + 3]);
   }
 #endif
 
@@ -5,6 +5,9 @@
 #ifndef TUNING_H
 #define TUNING_H
 
+/* fraction bits of the fixed point filter coefficients */
+#define TUNING_FILTER_FIXED_BITS 15
+
 enum
 {
   TUNING_SYSTEM_12_ET,
@@ -26,16 +29,30 @@ enum
   TUNING_FORK_AMIGA
 };
 
-extern float  G_frequency_table[];
+/* tables that depend on the tuning system and tuning fork */
+typedef struct tuning_tables
+{
+  int   tuning_system;
+  int   tuning_fork;
+
+  /* frequency table */
+  float frequency_table[4096];
+
+  /* phase increment table */
+  int   phase_increment_table[4096];
 
-extern int    G_phase_increment_table[];
+  /* filter coefficient tables */
+  float filter_omega_0_delta_t_over_2_table[4096];
+  float filter_stage_multiplier_table[4096];
 
-extern float  G_filter_omega_0_delta_t_over_2_table[];
-extern float  G_filter_stage_multiplier_table[];
+  int   filter_stage_multiplier_fixed_table[4096];
+} tuning_tables;
 
-extern float  G_resonance_table[];
+extern const float G_resonance_table[];
+extern const int   G_resonance_fixed_table[];
 
 /* function declarations */
-short int tuning_generate_tables();
+short int tuning_compute_tables(tuning_tables* t, 
+                                int tuning_system, int tuning_fork);
 
 #endif
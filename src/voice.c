@@ -39,8 +39,15 @@ short int voice_init(voice* v)
   if (v == NULL)
     return 1;
 
-  /* patch */
+  /* patch, compiled patch */
   v->p = NULL;
+  v->prog = NULL;
+
+  /* current state (rendered until it is known to be silent) */
+  v->state = VOICE_STATE_ACTIVE;
+
+  /* phase increment table */
+  v->tuning = NULL;
 
   /* base pitch table indices, phases */
   for (i = 0; i < PATCH_NUM_PHASES; i++)
@@ -50,7 +57,7 @@ short int voice_init(voice* v)
   }
 
   /* noise generator */
-  v->lfsr = 0x0001;
+  v->noise_index = 0;
 
   /* filter indices */
   v->base_fc_index = 0;
@@ -99,6 +106,8 @@ short int voice_deinit(voice* v)
     return 1;
 
   v->p = NULL;
+  v->prog = NULL;
+  v->tuning = NULL;
 
   filter_deinit(&v->lowpass);
 
@@ -241,7 +250,7 @@ short int voice_key_on(voice* v, char note, char volume)
     v->phase[1] = S_phi_table[p->phi];
 
   /* reset noise lfsr */
-  v->lfsr = 0x0001;
+  v->noise_index = 0;
 
   /* reset lfo phases */
   for (i = 0; i < PATCH_NUM_LFOS; i++)
@@ -249,7 +258,7 @@ short int voice_key_on(voice* v, char note, char volume)
     v->mod[i].cycles = -v->mod[i].padding;
     v->mod[i].index = 0;
     v->mod[i].level = 0;
-    v->mod[i].lfsr = 0x0001;
+    v->mod[i].noise_index = 0;
   }
 
   /* set voice volume */
@@ -262,6 +271,9 @@ short int voice_key_on(voice* v, char note, char volume)
   for (i = 0; i < PATCH_NUM_ENVELOPES; i++)
     envelope_change_state(&v->env[i], ENVELOPE_STATE_ATTACK);
 
+  /* wake up voice */
+  v->state = VOICE_STATE_ACTIVE;
+
   return 0;
 }
 
@@ -283,190 +295,299 @@ short int voice_key_off(voice* v)
 }
 
 /*******************************************************************************
-** voice_update()
+** voice_compile_program()
 *******************************************************************************/
-short int voice_update(voice* v)
+short int voice_compile_program(voice_program* vp, patch* p)
 {
-  int       i;
+  if ((vp == NULL) || (p == NULL))
+    return 1;
 
-  patch*    p;
+  /* wave generator kernel */
+  if (waveform_compile_program(&vp->wave, p))
+    return 1;
 
-  short int env_index[PATCH_NUM_ENVELOPES];
+  /* oscillator sync flags */
+  vp->sync[0] = ((p->sync == 1) || (p->sync == 3)) ? 1 : 0;
+  vp->sync[1] = ((p->sync == 2) || (p->sync == 3)) ? 1 : 0;
 
-  int       pitch_offset;
-  int       current_pitch_index;
+  /* phase shift applied to the 2nd oscillator on sync */
+  if ((p->phi >= 1) && (p->phi <= 7))
+    vp->phi_offset = S_phi_table[p->phi];
+  else
+    vp->phi_offset = 0;
 
-  int       fc_offset;
-  int       current_fc_index;
+  return 0;
+}
+
+/*******************************************************************************
+** voice_skip_block()
+*******************************************************************************/
+short int voice_skip_block(voice* v, int num_samples)
+{
+  int i;
+  int k;
+  int m;
 
-  int       level;
+  int attenuation[VOICE_BLOCK_SIZE];
 
   if (v == NULL)
     return 1;
 
-  /* set patch pointer */
-  p = v->p;
-
-  if (p == NULL)
-    return 1;
+  /* an idle voice is silent, but its envelope counters carry over */
+  /* to the next key on, so the envelopes keep running              */
+  for (k = 0; k < num_samples; k += m)
+  {
+    m = num_samples - k;
 
-  /* update lfos */
-  for (i = 0; i < PATCH_NUM_LFOS; i++)
-    lfo_update(&v->mod[i]);
+    if (m > VOICE_BLOCK_SIZE)
+      m = VOICE_BLOCK_SIZE;
 
-  /* update amplitude envelope */
-  envelope_update(&v->env[0]);
+    for (i = 0; i < PATCH_NUM_ENVELOPES; i++)
+      envelope_render_block(&v->env[i], attenuation, m);
+  }
 
-  env_index[0] = v->env[0].attenuation;
-  env_index[0] += v->env[0].total_bound;
-  env_index[0] += v->mod[1].level;
+  v->level = 0;
 
-  if (env_index[0] > 1023)
-    env_index[0] = 1023;
+  return 0;
+}
 
-  env_index[0] = env_index[0] << 2;
+/*******************************************************************************
+** voice_render_block()
+*******************************************************************************/
+short int voice_render_block(voice* v, int* buffer, int num_samples)
+{
+  int             i;
+  int             j;
+  int             k;
+  int             m;
 
-  /* update filter envelope */
-  envelope_update(&v->env[1]);
+  voice_program*  vp;
 
-  env_index[1] = v->env[1].attenuation;
-  env_index[1] += v->env[1].total_bound;
+  int             env_index;
+  int             filter_env_index;
 
-  if (env_index[1] > 1023)
-    env_index[1] = 1023;
+  int             pitch_offset;
+  int             current_pitch_index;
 
-  /* compute pitch offset (vibrato) */
-  pitch_offset = v->mod[0].level;
+  int             fc_offset;
+  int             fc_indices[VOICE_BLOCK_SIZE];
+  int             num_fc_indices;
 
-  /* update wave generators */
-  current_pitch_index = v->base_pitch_index[0] + pitch_offset;
+  int             amp_attenuation[VOICE_BLOCK_SIZE];
+  int             filter_attenuation[VOICE_BLOCK_SIZE];
 
-  if (current_pitch_index < 0)
-    v->phase[0] += G_phase_increment_table[0];
-  else if (current_pitch_index > 4095)
-    v->phase[0] += G_phase_increment_table[4095];
-  else
-    v->phase[0] += G_phase_increment_table[current_pitch_index];
+  int             vibrato[VOICE_BLOCK_SIZE];
+  int             tremolo[VOICE_BLOCK_SIZE];
+  int             wobble[VOICE_BLOCK_SIZE];
 
-  v->phase[0] &= 0xFFFFFFF;
+  int             phase_1[VOICE_BLOCK_SIZE];
+  int             phase_2[VOICE_BLOCK_SIZE];
+  int             noise_increment;
+  int             noise[VOICE_BLOCK_SIZE];
+  int             env_indices[VOICE_BLOCK_SIZE];
 
-  current_pitch_index = v->base_pitch_index[1] + pitch_offset;
+  int*            phase_increment_table;
 
-  if (current_pitch_index < 0)
-    v->phase[1] += G_phase_increment_table[0];
-  else if (current_pitch_index > 4095)
-    v->phase[1] += G_phase_increment_table[4095];
-  else
-    v->phase[1] += G_phase_increment_table[current_pitch_index];
+  if (v == NULL)
+    return 1;
 
-  v->phase[1] &= 0xFFFFFFF;
+  /* set compiled patch pointer */
+  vp = v->prog;
 
-  /* update sync generator */
-  current_pitch_index = v->base_pitch_index[2] + pitch_offset;
+  if ((v->p == NULL) || (vp == NULL) || (v->tuning == NULL))
+    return 1;
 
-  if (current_pitch_index < 0)
-    v->phase[2] += G_phase_increment_table[0];
-  else if (current_pitch_index > 4095)
-    v->phase[2] += G_phase_increment_table[4095];
-  else
-    v->phase[2] += G_phase_increment_table[current_pitch_index];
+  phase_increment_table = v->tuning->phase_increment_table;
 
-  if (v->phase[2] > 0xFFFFFFF)
+  /* the block is processed in pieces that fit the per sample buffers */
+  for (k = 0; k < num_samples; k += m)
   {
-    v->phase[2] &= 0xFFFFFFF;
+    m = num_samples - k;
+
+    if (m > VOICE_BLOCK_SIZE)
+      m = VOICE_BLOCK_SIZE;
+
+    /* idle voices are silent */
+    if (v->state == VOICE_STATE_IDLE)
+    {
+      voice_skip_block(v, m);
+
+      for (i = 0; i < m; i++)
+        buffer[k + i] = 0;
 
-    if ((p->sync == 1) || (p->sync == 3))
-      v->phase[0] = v->phase[2];
+      continue;
+    }
+
+    /* the envelopes & lfos do not depend on each other, so */
+    /* their levels are computed for the whole block         */
+    envelope_render_block(&v->env[0], amp_attenuation, m);
+    envelope_render_block(&v->env[1], filter_attenuation, m);
+
+    lfo_render_block(&v->mod[0], vibrato, m);
+    lfo_render_block(&v->mod[1], tremolo, m);
+    lfo_render_block(&v->mod[2], wobble, m);
 
-    if ((p->sync == 2) || (p->sync == 3))
+    /* control pass: update the generators at each sample */
+    for (i = 0; i < m; i++)
     {
-      if ((p->phi >= 1) && (p->phi <= 7))
-        v->phase[1] = v->phase[2] + S_phi_table[p->phi];
+      /* amplitude envelope */
+      env_index = amp_attenuation[i];
+      env_index += v->env[0].total_bound;
+      env_index += tremolo[i];
+
+      if (env_index > 1023)
+        env_index = 1023;
+
+      env_indices[i] = env_index << 2;
+
+      /* compute pitch offset (vibrato) */
+      pitch_offset = vibrato[i];
+
+      /* update wave generators */
+      current_pitch_index = v->base_pitch_index[0] + pitch_offset;
+
+      if (current_pitch_index < 0)
+        v->phase[0] += phase_increment_table[0];
+      else if (current_pitch_index > 4095)
+        v->phase[0] += phase_increment_table[4095];
       else
-        v->phase[1] = v->phase[2];
+        v->phase[0] += phase_increment_table[current_pitch_index];
+
+      v->phase[0] &= 0xFFFFFFF;
+
+      current_pitch_index = v->base_pitch_index[1] + pitch_offset;
+
+      if (current_pitch_index < 0)
+        v->phase[1] += phase_increment_table[0];
+      else if (current_pitch_index > 4095)
+        v->phase[1] += phase_increment_table[4095];
+      else
+        v->phase[1] += phase_increment_table[current_pitch_index];
 
       v->phase[1] &= 0xFFFFFFF;
-    }
-  }
 
-  /* update noise generator (nes) */
-  /* 15-bit lfsr, taps on 1 and 2 */
-  current_pitch_index = v->base_pitch_index[3];
+      /* update sync generator */
+      current_pitch_index = v->base_pitch_index[2] + pitch_offset;
 
-  if (current_pitch_index < 0)
-    v->phase[3] += G_phase_increment_table[0];
-  else if (current_pitch_index > 4095)
-    v->phase[3] += G_phase_increment_table[4095];
-  else
-    v->phase[3] += G_phase_increment_table[current_pitch_index];
+      if (current_pitch_index < 0)
+        v->phase[2] += phase_increment_table[0];
+      else if (current_pitch_index > 4095)
+        v->phase[2] += phase_increment_table[4095];
+      else
+        v->phase[2] += phase_increment_table[current_pitch_index];
 
-  if (v->phase[3] > 0xFFFFFFF)
-  {
-    if ((v->lfsr & 0x0001) ^ ((v->lfsr & 0x0002) >> 1))
-      v->lfsr = ((v->lfsr >> 1) & 0x3FFF) | 0x4000;
+      if (v->phase[2] > 0xFFFFFFF)
+      {
+        v->phase[2] &= 0xFFFFFFF;
+
+        if (vp->sync[0])
+          v->phase[0] = v->phase[2];
+
+        if (vp->sync[1])
+          v->phase[1] = (v->phase[2] + vp->phi_offset) & 0xFFFFFFF;
+      }
+
+      /* store the generator state for the wave pass */
+      phase_1[i] = v->phase[0] >> 18;
+      phase_2[i] = v->phase[1] >> 18;
+    }
+
+    /* noise pass: the noise generator (nes) steps through the lfsr */
+    /* sequence each time its phase wraps (its pitch is fixed)      */
+    current_pitch_index = v->base_pitch_index[3];
+
+    if (current_pitch_index < 0)
+      noise_increment = phase_increment_table[0];
+    else if (current_pitch_index > 4095)
+      noise_increment = phase_increment_table[4095];
     else
-      v->lfsr = (v->lfsr >> 1) & 0x3FFF;
+      noise_increment = phase_increment_table[current_pitch_index];
 
-    v->phase[3] &= 0xFFFFFFF;
-  }
+    for (i = 0; i < m; i++)
+    {
+      v->phase[3] += noise_increment;
 
-  /* compute level */
-  level = 0;
+      v->noise_index += v->phase[3] >> 28;
+      v->phase[3] &= 0xFFFFFFF;
 
-  /* additive wave mixing */
-  if (p->ring_mod == 0)
-  {
-    level += 
-      waveform_wave_lookup( p->waveform[0], (v->phase[0] >> 18), 
-                            (32 - p->wave_mix), (32 - p->noise_mix), 
-                            env_index[0]);
-
-    level += 
-      waveform_wave_lookup( p->waveform[1], (v->phase[1] >> 18), 
-                            p->wave_mix, (32 - p->noise_mix), 
-                            env_index[0]);
-  }
-  /* multiplicative wave mixing */
-  else if (p->ring_mod == 1)
-  {
-    level +=
-      waveform_ringmod_lookup(p->waveform[0], (v->phase[0] >> 18), 
-                              p->waveform[1], (v->phase[1] >> 18), 
-                              p->wave_mix, (32 - p->noise_mix), 
-                              env_index[0]);
-  }
+      if (v->noise_index >= WAVEFORM_NOISE_PERIOD)
+        v->noise_index -= WAVEFORM_NOISE_PERIOD;
+
+      noise[i] = G_noise_table[v->noise_index];
+    }
 
-  /* mix in noise */
-  level +=
-    waveform_noise_lookup(v->lfsr, p->noise_mix, env_index[0]);
+    /* filter pass: the cutoff is evaluated at the last sample of each */
+    /* control period, and the filter interpolates in between          */
+    num_fc_indices = 0;
 
-  /* determine current filter cutoff frequency                    */
-  /* filter envelope scaled so that its max value is 19 semitones */
-  /* thus, at C8, the max value reaches the highest midi note G9  */
-  fc_offset = (19 * (1023 - env_index[1])) / 32;
-  fc_offset += v->mod[2].level;
+    for (i = 0; i < m; i += v->lowpass.control_period)
+    {
+      j = i + v->lowpass.control_period - 1;
 
-  current_fc_index = v->base_fc_index + fc_offset;
+      if (j > m - 1)
+        j = m - 1;
 
-  if (current_fc_index < 0)
-    current_fc_index = 0;
-  else if (current_fc_index > 4095)
-    current_fc_index = 4095;
+      /* filter envelope */
+      filter_env_index = filter_attenuation[j];
+      filter_env_index += v->env[1].total_bound;
 
-  if (current_fc_index != v->lowpass.fc_index)
-    filter_set_indices(&v->lowpass, current_fc_index, p->resonance);
+      if (filter_env_index > 1023)
+        filter_env_index = 1023;
 
-  /* apply lowpass filter */
-  filter_update_lowpass(&v->lowpass, level);
+      /* determine current filter cutoff frequency                    */
+      /* filter envelope scaled so that its max value is 19 semitones */
+      /* thus, at C8, the max value reaches the highest midi note G9  */
+      fc_offset = (19 * (1023 - filter_env_index)) / 32;
+      fc_offset += wobble[j];
 
-  level = v->lowpass.level;
+      fc_offset += v->base_fc_index;
 
-  /* apply volume */
-  level = (level * v->volume) / 128;
+      if (fc_offset < 0)
+        fc_offset = 0;
+      else if (fc_offset > 4095)
+        fc_offset = 4095;
+
+      fc_indices[num_fc_indices++] = fc_offset;
+    }
+
+    /* wave pass: generate the unfiltered wave with the compiled kernel */
+    if (v->state == VOICE_STATE_ACTIVE)
+    {
+      waveform_render_block(&vp->wave, phase_1, phase_2, noise, env_indices, 
+                            &buffer[k], m);
+    }
+    else
+    {
+      for (i = 0; i < m; i++)
+        buffer[k + i] = 0;
+    }
+
+    /* apply lowpass filter */
+    filter_process_lowpass_block(&v->lowpass, &buffer[k], fc_indices, m);
+
+    /* apply volume */
+    for (i = 0; i < m; i++)
+      buffer[k + i] = (buffer[k + i] * v->volume) / 128;
+
+    /* once the amplitude envelope is at full attenuation outside of */
+    /* the attack, the wave stays at its floor until the next key on; */
+    /* if that floor is silent, the wave is muted                     */
+    if ((v->state == VOICE_STATE_ACTIVE)                  && 
+        (v->env[0].state != ENVELOPE_STATE_ATTACK)        && 
+        (v->env[0].attenuation >= 1023)                   && 
+        (vp->wave.silent_floor == 1))
+    {
+      v->state = VOICE_STATE_MUTED;
+    }
+
+    /* a muted voice is idle when its filter has come to rest */
+    if ((v->state == VOICE_STATE_MUTED) && filter_is_at_rest(&v->lowpass))
+      v->state = VOICE_STATE_IDLE;
+  }
 
   /* set voice level */
-  v->level = level;
+  if (num_samples > 0)
+    v->level = buffer[num_samples - 1];
 
   return 0;
 }
-
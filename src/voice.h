@@ -9,18 +9,47 @@
 #include "filter.h"
 #include "lfo.h"
 #include "patch.h"
+#include "tuning.h"
+#include "waveform.h"
+
+#define VOICE_BLOCK_SIZE 256
+
+enum
+{
+  VOICE_STATE_IDLE,
+  VOICE_STATE_ACTIVE,
+  VOICE_STATE_MUTED
+};
+
+/* patch settings compiled for the render loop */
+typedef struct voice_program
+{
+  /* wave generator kernel */
+  waveform_program  wave;
+
+  /* oscillator sync flags, phase shift */
+  int               sync[PATCH_NUM_WAVES];
+  int               phi_offset;
+} voice_program;
 
 typedef struct voice
 {
-  /* patch */
-  patch*        p;
+  /* patch, compiled patch */
+  patch*          p;
+  voice_program*  prog;
+
+  /* current state (idle/active/muted) */
+  int             state;
+
+  /* phase increment table */
+  tuning_tables* tuning;
 
   /* base pitch table indices, phases */
   int           base_pitch_index[PATCH_NUM_PHASES];
   int           phase[PATCH_NUM_PHASES];
 
-  /* noise generator */
-  unsigned int  lfsr;
+  /* noise generator (position in the lfsr sequence) */
+  int           noise_index;
 
   /* filter indices */
   int           base_fc_index;
@@ -49,6 +78,8 @@ short int   voice_destroy(voice* v);
 
 short int   voice_key_on(voice* v, char note, char volume);
 short int   voice_key_off(voice* v);
-short int   voice_update(voice* v);
+short int   voice_compile_program(voice_program* vp, patch* p);
+short int   voice_skip_block(voice* v, int num_samples);
+short int   voice_render_block(voice* v, int* buffer, int num_samples);
 
 #endif
@@ -5,447 +5,509 @@
 #include <stdio.h>
 #include <math.h>
 
-#include "waveform.h"
-
-static short int S_db_to_linear[8192];
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define WAVEFORM_X86_SIMD
+#include <immintrin.h>
+#endif
 
-static short int S_wavetable_saw[1024];
-static short int S_wavetable_tri[512];
+#include "waveform.h"
 
-static short int S_wave_mix_linear[33];
+/* db to linear, wave mix and packed wave tables (generated by tabgen) */
+#include "waveform_tables.h"
 
-static short int S_geometric_saw[1024];
-static short int S_geometric_tri[512];
+/* each packed wave table entry is the wave index shifted up by one, with */
+/* the negative flag in the low bit. the sign is applied without a branch */
+/* by using the flag as a mask: (x ^ -flag) + flag is x or -x.            */
 
 /*******************************************************************************
-** waveform_generate_tables()
+** waveform_mix_attenuation()
 *******************************************************************************/
-short int waveform_generate_tables()
+static int waveform_mix_attenuation(int mix)
 {
-  int     i;
-  double  val;
+  if ((mix >= 0) && (mix <= 32))
+    return S_wave_mix_linear[mix];
+  else
+    return 0;
+}
 
-  /* ym2612 - 10 bit envelope (shifted to 12 bit), 12 bit sine, 13 bit sum    */
-  /* 10 bit db: 24, 12, 6, 3, 1.5, 0.75, 0.375, 0.1875, 0.09375, 0.046875     */
-  /* 12 bit db: adds on 0.0234375, 0.01171875 in back                         */
-  /* 13 bit db: adds on 48 in front                                           */
+/*******************************************************************************
+** waveform_term_is_silent()
+*******************************************************************************/
+static int waveform_term_is_silent(int att_index)
+{
+  int final_index;
 
-  /* db to linear scale conversion */
-  S_db_to_linear[0] = 32767;
+  /* the table offsets are not negative, so a term at full envelope */
+  /* attenuation is loudest at its mix attenuation plus the envelope */
+  final_index = att_index + (1023 << 2);
 
-  for (i = 1; i < 8191; i++)
-  {
-    S_db_to_linear[i] = 
-      (short int) ((32767.0f * exp(-log(10) * (DB_STEP / 10) * i)) + 0.5f);
-  }
-
-  S_db_to_linear[8191] = 0;
+  if (final_index > 8191)
+    final_index = 8191;
 
-  /* wavetable (sawtooth) */
-  S_wavetable_saw[0] = 4095;
-  S_wavetable_saw[512] = 0;
+  return (S_db_to_linear[final_index] == 0) ? 1 : 0;
+}
 
-  for (i = 1; i < 512; i++)
+/*******************************************************************************
+** waveform_render_additive()
+*******************************************************************************/
+static void waveform_render_additive( waveform_program* wp, 
+                                      int* phase_1, int* phase_2, 
+                                      int* noise, int* env_index, 
+                                      int* buffer, int num_samples)
+{
+  int i;
+
+  const short int*  table_1;
+  const short int*  table_2;
+  int               att_index_1;
+  int               att_index_2;
+  int               noise_att_index;
+
+  int               entry;
+  int               final_index;
+  int               negative;
+  int               level;
+
+  table_1 = wp->table[0];
+  table_2 = wp->table[1];
+  att_index_1 = wp->att_index[0];
+  att_index_2 = wp->att_index[1];
+  noise_att_index = wp->noise_att_index;
+
+  for (i = 0; i < num_samples; i++)
   {
-    val = i / 512.0f;
-    S_wavetable_saw[i] = (short int) ((10 * (log(1 / val) / log(10)) / DB_STEP) + 0.5f);
-    S_wavetable_saw[1024 - i] = S_wavetable_saw[i];
-  }
+    /* wave 1 */
+    entry = table_1[phase_1[i]];
 
-  /* wavetable (triangle) */
-  S_wavetable_tri[0] = 4095;
-  S_wavetable_tri[256] = 0;
-
-  for (i = 1; i < 256; i++)
-  {
-    val = i / 256.0f;
-    S_wavetable_tri[i] = (short int) ((10 * (log(1 / val) / log(10)) / DB_STEP) + 0.5f);
-    S_wavetable_tri[512 - i] = S_wavetable_tri[i];
-  }
+    final_index = (entry >> 1) + att_index_1 + env_index[i];
 
-  /* wave mix (linear weights) */
-  S_wave_mix_linear[0] = 4096;
+    if (final_index > 8191)
+      final_index = 8191;
 
-  for (i = 1; i < 32; i++)
-  {
-    val = i / 32.0f;
-    S_wave_mix_linear[i] = (short int) ((10 * (log(1 / val) / log(10)) / DB_STEP) + 0.5f);
-  }
+    negative = entry & 1;
+    level = (S_db_to_linear[final_index] ^ -negative) + negative;
 
-  S_wave_mix_linear[32] = 0;
+    /* wave 2 */
+    entry = table_2[phase_2[i]];
 
-  /* the geometric tables are used to perform wave mixing with ring mod       */
-  /* each sample in the original wavetable is raised to the 1/32 power        */
-  /* note that the two waveforms are mixed with the expression (x^w1)(y^w2),  */
-  /* where w1 and w2 are weights in the form 0/32, 1/32, ..., 32/32.          */
+    final_index = (entry >> 1) + att_index_2 + env_index[i];
 
-  /* wavetable (sawtooth) - geometric */
-  S_geometric_saw[0] = 4095;
-  S_geometric_saw[512] = 0;
+    if (final_index > 8191)
+      final_index = 8191;
 
-  for (i = 1; i < 512; i++)
-  {
-    val = i / 512.0f;
-    val = pow(val, 0.03125f);
+    negative = entry & 1;
+    level += (S_db_to_linear[final_index] ^ -negative) + negative;
 
-    S_geometric_saw[i] = (short int) ((10 * (log(1 / val) / log(10)) / DB_STEP) + 0.5f);
-    S_geometric_saw[1024 - i] = S_geometric_saw[i];
-  }
+    /* noise */
+    final_index = noise_att_index + env_index[i];
 
-  /* wavetable (triangle) - geometric */
-  S_geometric_tri[0] = 4095;
-  S_geometric_tri[256] = 0;
+    if (final_index > 8191)
+      final_index = 8191;
 
-  for (i = 1; i < 256; i++)
-  {
-    val = i / 256.0f;
-    val = pow(val, 0.03125f);
+    negative = noise[i];
+    level += (S_db_to_linear[final_index] ^ -negative) + negative;
 
-    S_geometric_tri[i] = (short int) ((10 * (log(1 / val) / log(10)) / DB_STEP) + 0.5f);
-    S_geometric_tri[512 - i] = S_geometric_tri[i];
+    buffer[i] = level;
   }
-
-  return 0;
 }
 
 /*******************************************************************************
-** waveform_wave_lookup()
+** waveform_render_ringmod()
 *******************************************************************************/
-short int waveform_wave_lookup( int type, int phase, 
-                                int wave_mix, int noise_mix, int env_index)
+static void waveform_render_ringmod(waveform_program* wp, 
+                                    int* phase_1, int* phase_2, 
+                                    int* noise, int* env_index, 
+                                    int* buffer, int num_samples)
 {
-  int       att_index;
+  int i;
+
+  const short int*  table_1;
+  const short int*  table_2;
+  int               weight_1;
+  int               weight_2;
+  int               att_index;
+  int               noise_att_index;
+
+  int               entry_1;
+  int               entry_2;
+  int               final_index;
+  int               negative;
+  int               level;
+
+  table_1 = wp->table[0];
+  table_2 = wp->table[1];
+  weight_1 = wp->weight[0];
+  weight_2 = wp->weight[1];
+  att_index = wp->att_index[0];
+  noise_att_index = wp->noise_att_index;
+
+  for (i = 0; i < num_samples; i++)
+  {
+    /* product of the two waves */
+    entry_1 = table_1[phase_1[i]];
+    entry_2 = table_2[phase_2[i]];
 
-  int       wave_index;
-  char      negative;
+    final_index = (weight_1 * (entry_1 >> 1)) + 
+                  (weight_2 * (entry_2 >> 1)) + 
+                  att_index + env_index[i];
 
-  int       final_index;
+    if (final_index > 8191)
+      final_index = 8191;
 
-  short int level;
+    negative = (entry_1 ^ entry_2) & 1;
+    level = (S_db_to_linear[final_index] ^ -negative) + negative;
 
-  /* bound phase */
-  phase &= 0x3FF;
+    /* noise */
+    final_index = noise_att_index + env_index[i];
 
-  /* determine mix attenuation index */
-  if ((wave_mix >= 0) && (wave_mix <= 32))
-    att_index = S_wave_mix_linear[wave_mix];
-  else
-    att_index = 0;
+    if (final_index > 8191)
+      final_index = 8191;
 
-  if ((noise_mix >= 0) && (noise_mix <= 32))
-    att_index += S_wave_mix_linear[noise_mix];
+    negative = noise[i];
+    level += (S_db_to_linear[final_index] ^ -negative) + negative;
 
-  /* determine wave index & negative flag */
-  if (type == OSC_WAVEFORM_SQUARE)
-  {
-    wave_index = 0;
-
-    if (phase < 512)
-      negative = 0;
-    else
-      negative = 1;
+    buffer[i] = level;
   }
-  else if (type == OSC_WAVEFORM_SAW)
-  {
-    wave_index = S_wavetable_saw[phase];
+}
 
-    if (phase < 512)
-      negative = 0;
-    else
-      negative = 1;
-  }
-  else if (type == OSC_WAVEFORM_TRIANGLE)
-  {
-    if (phase < 512)
-    {
-      wave_index = S_wavetable_tri[phase];
-      negative = 0;
-    }
-    else
-    {
-      wave_index = S_wavetable_tri[phase - 512];
-      negative = 1;
-    }
-  }
-  else if (type == OSC_WAVEFORM_PULSE_1_8)
-  {
-    wave_index = 0;
+/*******************************************************************************
+** waveform_render_noise()
+*******************************************************************************/
+static void waveform_render_noise(waveform_program* wp, 
+                                  int* phase_1, int* phase_2, 
+                                  int* noise, int* env_index, 
+                                  int* buffer, int num_samples)
+{
+  int i;
 
-    if (phase < 128)
-      negative = 0;
-    else
-      negative = 1;
-  }
-  else if (type == OSC_WAVEFORM_PULSE_1_4)
-  {
-    wave_index = 0;
+  int noise_att_index;
+  int final_index;
+  int negative;
 
-    if (phase < 256)
-      negative = 0;
-    else
-      negative = 1;
-  }
-  else if (type == OSC_WAVEFORM_PULSE_3_8)
-  {
-    wave_index = 0;
+  (void) phase_1;
+  (void) phase_2;
 
-    if (phase < 384)
-      negative = 0;
-    else
-      negative = 1;
-  }
-  else if (type == OSC_WAVEFORM_PULSE_1_16)
-  {
-    wave_index = 0;
+  noise_att_index = wp->noise_att_index;
 
-    if (phase < 64)
-      negative = 0;
-    else
-      negative = 1;
-  }
-  else if (type == OSC_WAVEFORM_PULSE_3_16)
+  for (i = 0; i < num_samples; i++)
   {
-    wave_index = 0;
+    final_index = noise_att_index + env_index[i];
 
-    if (phase < 192)
-      negative = 0;
-    else
-      negative = 1;
-  }
-  else if (type == OSC_WAVEFORM_PULSE_5_16)
-  {
-    wave_index = 0;
+    if (final_index > 8191)
+      final_index = 8191;
 
-    if (phase < 320)
-      negative = 0;
-    else
-      negative = 1;
+    negative = noise[i];
+    buffer[i] = (S_db_to_linear[final_index] ^ -negative) + negative;
   }
-  else if (type == OSC_WAVEFORM_PULSE_7_16)
-  {
-    wave_index = 0;
+}
 
-    if (phase < 448)
-      negative = 0;
-    else
-      negative = 1;
-  }
-  else
-  {
-    wave_index = 0;
-    negative = 0;
-  }
+/* kernels (the scalar versions are used until the kernels are selected) */
+static void (*S_waveform_render_additive)(waveform_program* wp, 
+                                          int* phase_1, int* phase_2, 
+                                          int* noise, int* env_index, 
+                                          int* buffer, int num_samples) 
+            = waveform_render_additive;
+
+static void (*S_waveform_render_ringmod)( waveform_program* wp, 
+                                          int* phase_1, int* phase_2, 
+                                          int* noise, int* env_index, 
+                                          int* buffer, int num_samples) 
+            = waveform_render_ringmod;
+
+#ifdef WAVEFORM_X86_SIMD
+/* The avx2 kernels compute 8 samples at a time with gathers. Each table */
+/* entry is fetched as the aligned 32 bit word that contains it, so that */
+/* no gather reads past the end of a table, and then shifted into place. */
+/* The integer math is the same as in the scalar kernels, so the output  */
+/* does not depend on which kernel is chosen.                            */
 
-  /* determine attenuated & enveloped wave value */
-  final_index = wave_index + att_index + env_index;
+/*******************************************************************************
+** waveform_gather_avx2()
+*******************************************************************************/
+__attribute__((target("avx2")))
+static __m256i waveform_gather_avx2(const short int* table, __m256i index)
+{
+  __m256i words;
+  __m256i shift;
 
-  if (final_index < 0)
-    final_index = 0;
-  else if (final_index > 8191)
-    final_index = 8191;
+  words = _mm256_i32gather_epi32( (const int*) table, 
+                                  _mm256_srli_epi32(index, 1), 4);
+  shift = _mm256_slli_epi32(_mm256_and_si256(index, _mm256_set1_epi32(1)), 4);
 
-  if (negative == 1)
-    level = -S_db_to_linear[final_index];
-  else
-    level = S_db_to_linear[final_index];
+  return _mm256_and_si256(_mm256_srlv_epi32(words, shift), 
+                          _mm256_set1_epi32(0xFFFF));
+}
 
-  return level;
+/*******************************************************************************
+** waveform_level_avx2()
+*******************************************************************************/
+__attribute__((target("avx2")))
+static __m256i waveform_level_avx2(__m256i final_index, __m256i negative)
+{
+  __m256i level;
+
+  final_index = _mm256_max_epi32(final_index, _mm256_setzero_si256());
+  final_index = _mm256_min_epi32(final_index, _mm256_set1_epi32(8191));
+
+  level = waveform_gather_avx2(S_db_to_linear, final_index);
+
+  return _mm256_add_epi32(_mm256_xor_si256(level, 
+                                           _mm256_sub_epi32(_mm256_setzero_si256(), negative)), 
+                          negative);
 }
 
 /*******************************************************************************
-** waveform_ringmod_lookup()
+** waveform_render_additive_avx2()
 *******************************************************************************/
-short int waveform_ringmod_lookup(int type_1, int phase_1, 
-                                  int type_2, int phase_2, 
-                                  int wave_mix, int noise_mix, int env_index)
+__attribute__((target("avx2")))
+static void waveform_render_additive_avx2(waveform_program* wp, 
+                                          int* phase_1, int* phase_2, 
+                                          int* noise, int* env_index, 
+                                          int* buffer, int num_samples)
 {
-  int       i;
+  int i;
 
-  int       type[2];
-  int       phase[2];
+  __m256i one;
+  __m256i att_index_1;
+  __m256i att_index_2;
+  __m256i noise_att_index;
 
-  int       att_index;
+  __m256i env;
+  __m256i entry;
+  __m256i level;
 
-  int       wave_index[2];
-  char      negative;
+  one = _mm256_set1_epi32(1);
+  att_index_1 = _mm256_set1_epi32(wp->att_index[0]);
+  att_index_2 = _mm256_set1_epi32(wp->att_index[1]);
+  noise_att_index = _mm256_set1_epi32(wp->noise_att_index);
 
-  int       final_index;
+  for (i = 0; i + 8 <= num_samples; i += 8)
+  {
+    env = _mm256_loadu_si256((__m256i*) &env_index[i]);
+
+    /* wave 1 */
+    entry = waveform_gather_avx2( wp->table[0], 
+                                  _mm256_loadu_si256((__m256i*) &phase_1[i]));
+
+    level = waveform_level_avx2(
+              _mm256_add_epi32( _mm256_add_epi32( _mm256_srli_epi32(entry, 1), 
+                                                  att_index_1), env), 
+              _mm256_and_si256(entry, one));
+
+    /* wave 2 */
+    entry = waveform_gather_avx2( wp->table[1], 
+                                  _mm256_loadu_si256((__m256i*) &phase_2[i]));
+
+    level = _mm256_add_epi32(level, 
+              waveform_level_avx2(
+                _mm256_add_epi32( _mm256_add_epi32( _mm256_srli_epi32(entry, 1), 
+                                                    att_index_2), env), 
+                _mm256_and_si256(entry, one)));
+
+    /* noise */
+    level = _mm256_add_epi32(level, 
+              waveform_level_avx2(
+                _mm256_add_epi32(noise_att_index, env), 
+                _mm256_loadu_si256((__m256i*) &noise[i])));
+
+    _mm256_storeu_si256((__m256i*) &buffer[i], level);
+  }
 
-  short int level;
+  /* remaining samples */
+  if (i < num_samples)
+  {
+    waveform_render_additive( wp, &phase_1[i], &phase_2[i], 
+                              &noise[i], &env_index[i], 
+                              &buffer[i], num_samples - i);
+  }
+}
 
-  /* copy type and phase of each wave to local arrays */
-  type[0] = type_1;
-  type[1] = type_2;
+/*******************************************************************************
+** waveform_render_ringmod_avx2()
+*******************************************************************************/
+__attribute__((target("avx2")))
+static void waveform_render_ringmod_avx2( waveform_program* wp, 
+                                          int* phase_1, int* phase_2, 
+                                          int* noise, int* env_index, 
+                                          int* buffer, int num_samples)
+{
+  int i;
+
+  __m256i one;
+  __m256i weight_1;
+  __m256i weight_2;
+  __m256i att_index;
+  __m256i noise_att_index;
+
+  __m256i env;
+  __m256i entry_1;
+  __m256i entry_2;
+  __m256i final_index;
+  __m256i level;
+
+  one = _mm256_set1_epi32(1);
+  weight_1 = _mm256_set1_epi32(wp->weight[0]);
+  weight_2 = _mm256_set1_epi32(wp->weight[1]);
+  att_index = _mm256_set1_epi32(wp->att_index[0]);
+  noise_att_index = _mm256_set1_epi32(wp->noise_att_index);
+
+  for (i = 0; i + 8 <= num_samples; i += 8)
+  {
+    env = _mm256_loadu_si256((__m256i*) &env_index[i]);
+
+    /* product of the two waves */
+    entry_1 = waveform_gather_avx2( wp->table[0], 
+                                    _mm256_loadu_si256((__m256i*) &phase_1[i]));
+    entry_2 = waveform_gather_avx2( wp->table[1], 
+                                    _mm256_loadu_si256((__m256i*) &phase_2[i]));
+
+    final_index = _mm256_add_epi32(
+                    _mm256_mullo_epi32(weight_1, _mm256_srli_epi32(entry_1, 1)), 
+                    _mm256_mullo_epi32(weight_2, _mm256_srli_epi32(entry_2, 1)));
+    final_index = _mm256_add_epi32(final_index, _mm256_add_epi32(att_index, env));
+
+    level = waveform_level_avx2(final_index, 
+                                _mm256_and_si256( _mm256_xor_si256(entry_1, entry_2), 
+                                                  one));
+
+    /* noise */
+    level = _mm256_add_epi32(level, 
+              waveform_level_avx2(
+                _mm256_add_epi32(noise_att_index, env), 
+                _mm256_loadu_si256((__m256i*) &noise[i])));
+
+    _mm256_storeu_si256((__m256i*) &buffer[i], level);
+  }
 
-  phase[0] = phase_1;
-  phase[1] = phase_2;
+  /* remaining samples */
+  if (i < num_samples)
+  {
+    waveform_render_ringmod(wp, &phase_1[i], &phase_2[i], 
+                            &noise[i], &env_index[i], 
+                            &buffer[i], num_samples - i);
+  }
+}
+#endif
 
-  /* determine mix attenuation index */
-  if ((noise_mix >= 0) && (noise_mix <= 32))
-    att_index = S_wave_mix_linear[noise_mix];
-  else
-    att_index = 0;
+/*******************************************************************************
+** waveform_select_kernels()
+*******************************************************************************/
+short int waveform_select_kernels()
+{
+  /* choose the wave kernels for this processor */
+  S_waveform_render_additive = waveform_render_additive;
+  S_waveform_render_ringmod = waveform_render_ringmod;
 
-  /* determine wave indices & negative flag */
-  negative = 0;
+#ifdef WAVEFORM_X86_SIMD
+  __builtin_cpu_init();
 
-  for (i = 0; i < 2; i++)
+  if (__builtin_cpu_supports("avx2"))
   {
-    if (type[i] == OSC_WAVEFORM_SQUARE)
-    {
-      wave_index[i] = 0;
+    S_waveform_render_additive = waveform_render_additive_avx2;
+    S_waveform_render_ringmod = waveform_render_ringmod_avx2;
+  }
+#endif
 
-      if (phase[i] < 512)
-        negative += 0;
-      else
-        negative += 1;
-    }
-    else if (type[i] == OSC_WAVEFORM_SAW)
-    {
-      wave_index[i] = S_geometric_saw[phase[i]];
+  return 0;
+}
 
-      if (phase[i] < 512)
-        negative += 0;
-      else
-        negative += 1;
-    }
-    else if (type[i] == OSC_WAVEFORM_TRIANGLE)
-    {
-      if (phase[i] < 512)
-      {
-        wave_index[i] = S_geometric_tri[phase[i]];
-        negative += 0;
-      }
-      else
-      {
-        wave_index[i] = S_geometric_tri[phase[i] - 512];
-        negative += 1;
-      }
-    }
-    else if (type[i] == OSC_WAVEFORM_PULSE_1_8)
-    {
-      wave_index[i] = 0;
+/*******************************************************************************
+** waveform_compile_program()
+*******************************************************************************/
+short int waveform_compile_program(waveform_program* wp, patch* p)
+{
+  int i;
+  int type;
 
-      if (phase[i] < 128)
-        negative += 0;
-      else
-        negative += 1;
-    }
-    else if (type[i] == OSC_WAVEFORM_PULSE_1_4)
-    {
-      wave_index[i] = 0;
+  if ((wp == NULL) || (p == NULL))
+    return 1;
 
-      if (phase[i] < 256)
-        negative += 0;
-      else
-        negative += 1;
-    }
-    else if (type[i] == OSC_WAVEFORM_PULSE_3_8)
-    {
-      wave_index[i] = 0;
+  /* select packed wave tables (unknown waveforms use the silent row) */
+  for (i = 0; i < PATCH_NUM_WAVES; i++)
+  {
+    type = p->waveform[i];
 
-      if (phase[i] < 384)
-        negative += 0;
-      else
-        negative += 1;
-    }
-    else if (type[i] == OSC_WAVEFORM_PULSE_1_16)
-    {
-      wave_index[i] = 0;
+    if ((type < 0) || (type >= WAVEFORM_NUM_TYPES))
+      type = WAVEFORM_NUM_TYPES;
 
-      if (phase[i] < 64)
-        negative += 0;
-      else
-        negative += 1;
-    }
-    else if (type[i] == OSC_WAVEFORM_PULSE_3_16)
-    {
-      wave_index[i] = 0;
+    if (p->ring_mod == 1)
+      wp->table[i] = S_ringmod_table[type];
+    else
+      wp->table[i] = S_wave_table[type];
+  }
 
-      if (phase[i] < 192)
-        negative += 0;
-      else
-        negative += 1;
-    }
-    else if (type[i] == OSC_WAVEFORM_PULSE_5_16)
-    {
-      wave_index[i] = 0;
+  /* additive wave mixing */
+  if (p->ring_mod == 0)
+  {
+    wp->att_index[0] =  waveform_mix_attenuation(32 - p->wave_mix) + 
+                        waveform_mix_attenuation(32 - p->noise_mix);
+    wp->att_index[1] =  waveform_mix_attenuation(p->wave_mix) + 
+                        waveform_mix_attenuation(32 - p->noise_mix);
 
-      if (phase[i] < 320)
-        negative += 0;
-      else
-        negative += 1;
-    }
-    else if (type[i] == OSC_WAVEFORM_PULSE_7_16)
-    {
-      wave_index[i] = 0;
+    wp->weight[0] = 0;
+    wp->weight[1] = 0;
 
-      if (phase[i] < 448)
-        negative += 0;
-      else
-        negative += 1;
+    wp->render = S_waveform_render_additive;
+  }
+  /* multiplicative wave mixing */
+  else if (p->ring_mod == 1)
+  {
+    wp->att_index[0] = waveform_mix_attenuation(32 - p->noise_mix);
+    wp->att_index[1] = 0;
+
+    if ((p->wave_mix >= 0) && (p->wave_mix <= 32))
+    {
+      wp->weight[0] = 32 - p->wave_mix;
+      wp->weight[1] = p->wave_mix;
     }
     else
     {
-      wave_index[i] = 0;
-      negative += 0;
+      wp->weight[0] = 32;
+      wp->weight[1] = 0;
     }
-  }
 
-  /* determine attenuated & enveloped value */
-  if ((wave_mix >= 0) && (wave_mix <= 32))
-  {
-    final_index = ((32 - wave_mix) * wave_index[0]) + 
-                  (wave_mix * wave_index[1]) + att_index + env_index;
+    wp->render = S_waveform_render_ringmod;
   }
+  /* noise only */
   else
   {
-    final_index = 32 * wave_index[0] + att_index + env_index;
+    wp->att_index[0] = 0;
+    wp->att_index[1] = 0;
+
+    wp->weight[0] = 0;
+    wp->weight[1] = 0;
+
+    wp->render = waveform_render_noise;
   }
 
-  if (final_index < 0)
-    final_index = 0;
-  else if (final_index > 8191)
-    final_index = 8191;
+  wp->noise_att_index = waveform_mix_attenuation(p->noise_mix);
 
-  if (negative == 1)
-    level = -S_db_to_linear[final_index];
-  else
-    level = S_db_to_linear[final_index];
+  /* check if each term of the wave is silent at full attenuation */
+  wp->silent_floor = waveform_term_is_silent(wp->noise_att_index);
 
-  return level;
+  if (p->ring_mod == 0)
+  {
+    wp->silent_floor &= waveform_term_is_silent(wp->att_index[0]);
+    wp->silent_floor &= waveform_term_is_silent(wp->att_index[1]);
+  }
+  else if (p->ring_mod == 1)
+    wp->silent_floor &= waveform_term_is_silent(wp->att_index[0]);
+
+  return 0;
 }
 
 /*******************************************************************************
-** waveform_noise_lookup()
+** waveform_render_block()
 *******************************************************************************/
-short int waveform_noise_lookup(int lfsr, int noise_mix, int env_index)
+short int waveform_render_block(waveform_program* wp, 
+                                int* phase_1, int* phase_2, 
+                                int* noise, int* env_index, 
+                                int* buffer, int num_samples)
 {
-  int       att_index;
-
-  int       final_index;
+  if ((wp == NULL) || (wp->render == NULL))
+    return 1;
 
-  short int level;
+  wp->render(wp, phase_1, phase_2, noise, env_index, buffer, num_samples);
 
-  /* determine mix attenuation index */
-  if ((noise_mix >= 0) && (noise_mix <= 32))
-    att_index = S_wave_mix_linear[noise_mix];
-  else
-    att_index = 0;
-
-  /* determine attenuated & enveloped wave value */
-  final_index = att_index + env_index;
-
-  if (final_index < 0)
-    final_index = 0;
-  else if (final_index > 8191)
-    final_index = 8191;
-
-  if (lfsr & 0x0001)
-    level = -S_db_to_linear[final_index];
-  else
-    level = S_db_to_linear[final_index];
-
-  return level;
+  return 0;
 }
-
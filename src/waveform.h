@@ -5,6 +5,8 @@
 #ifndef WAVEFORM_H
 #define WAVEFORM_H
 
+#include "patch.h"
+
 #define DB_STEP 0.01171875
 
 enum
@@ -21,14 +23,42 @@ enum
   OSC_WAVEFORM_PULSE_7_16
 };
 
+#define WAVEFORM_NUM_TYPES 10
+
+/* the noise generator steps through the sequence of a 15-bit lfsr; */
+/* the table holds its output bit (the noise sign) at each step      */
+#define WAVEFORM_NOISE_PERIOD 32767
+
+extern const char G_noise_table[];
+
+/* a patch compiled into the tables and weights used for each wave, */
+/* so that rendering a block does not look at the patch settings     */
+typedef struct waveform_program
+{
+  /* packed wave table (wave index << 1 | negative flag) indexed by phase */
+  const short int*  table[PATCH_NUM_WAVES];
+
+  /* mix attenuation (additive) or mix weights (ring mod) */
+  int               att_index[PATCH_NUM_WAVES];
+  int               weight[PATCH_NUM_WAVES];
+  int               noise_att_index;
+
+  /* set if the wave is silent at full envelope attenuation */
+  int               silent_floor;
+
+  /* block kernel (additive or ring mod) */
+  void (*render)( struct waveform_program* wp, 
+                  int* phase_1, int* phase_2, int* noise, int* env_index, 
+                  int* buffer, int num_samples);
+} waveform_program;
+
 /* function declarations */
-short int waveform_generate_tables();
-
-short int waveform_wave_lookup( int type, int phase, 
-                                int wave_mix, int noise_mix, int env_index);
-short int waveform_ringmod_lookup(int type_1, int phase_1, 
-                                  int type_2, int phase_2, 
-                                  int wave_mix, int noise_mix, int env_index);
-short int waveform_noise_lookup(int lfsr, int noise_mix, int env_index);
+short int waveform_select_kernels();
+
+short int waveform_compile_program(waveform_program* wp, patch* p);
+short int waveform_render_block(waveform_program* wp, 
+                                int* phase_1, int* phase_2, 
+                                int* noise, int* env_index, 
+                                int* buffer, int num_samples);
 
 #endif
@@ -0,0 +1,776 @@
+/*******************************************************************************
+** tabgen.c (lookup table generator)
+*******************************************************************************/
+
+/*******************************************************************************
+** This program is run during the build. It computes the lookup tables that do
+** not depend on the song settings, and writes them out as const arrays:
+**
+**   tabgen <module>
+**
+** The output is a header that is included by src/<module>.c, so that the
+** tables are placed in read only data instead of being generated at startup.
+*******************************************************************************/
+
+#define _ISOC99_SOURCE  /* tanhf */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "global.h"
+#include "sequence.h"
+#include "tuning.h"
+#include "waveform.h"
+
+enum
+{
+  TABGEN_TYPE_CHAR,
+  TABGEN_TYPE_SHORT,
+  TABGEN_TYPE_INT,
+  TABGEN_TYPE_FLOAT
+};
+
+/* waveform tables */
+static short int  S_db_to_linear[8192];
+
+static short int  S_wavetable_saw[1024];
+static short int  S_wavetable_tri[512];
+
+static short int  S_wave_mix_linear[33];
+
+static short int  S_geometric_saw[1024];
+static short int  S_geometric_tri[512];
+
+static short int  S_wave_table[WAVEFORM_NUM_TYPES + 1][1024];
+static short int  S_ringmod_table[WAVEFORM_NUM_TYPES + 1][1024];
+
+static char       S_noise_table[WAVEFORM_NOISE_PERIOD];
+
+/* lfo tables */
+static short int  S_vib_table[4][16][128];
+static short int  S_trem_table[4][16][128];
+static short int  S_wob_table[4][16][128];
+
+/* waveshaping table */
+static int        S_waveshaper_tanh_table[8192];
+
+/* sequencer tables */
+static int        S_sequencer_period_table[224];
+static char       S_scale_table[84][21][49];
+
+/* semitone jump pattern for each base scale (1st mode) */
+static char S_scale_semitone_jump_pattern[12][7] = 
+  { {2, 2, 1, 2, 2, 2, 1},  /* ionian           */
+    {2, 1, 2, 2, 2, 2, 1},  /* melodic minor    */
+    {2, 1, 2, 2, 1, 3, 1},  /* harmonic minor   */
+    {2, 2, 1, 2, 1, 3, 1},  /* harmonic major   */
+    {1, 3, 1, 2, 1, 3, 1},  /* double harmonic  */
+    {1, 2, 2, 2, 1, 3, 1},  /* neapolitan minor */
+    {1, 2, 2, 2, 2, 2, 1},  /* neapolitan major */
+    {3, 1, 2, 1, 2, 1, 2},  /* hungarian major  */
+    {1, 3, 2, 1, 2, 1, 2},  /* romanian major   */
+    {1, 3, 1, 1, 2, 3, 1},  /* persian          */
+    {1, 3, 2, 2, 2, 1, 1},  /* enigmatic        */
+    {1, 1, 3, 2, 1, 1, 3}   /* kanakangi        */
+  };
+
+/* filter resonance table */
+static float      S_resonance_table[32];
+static int        S_resonance_fixed_table[32];
+
+/*******************************************************************************
+** tabgen_wave_entry()
+*******************************************************************************/
+static short int tabgen_wave_entry( int type, int phase, 
+                                    short int* saw, short int* tri)
+{
+  int wave_index;
+  int threshold;
+
+  /* determine wave index */
+  if (type == OSC_WAVEFORM_SAW)
+    wave_index = saw[phase];
+  else if (type == OSC_WAVEFORM_TRIANGLE)
+    wave_index = tri[phase % 512];
+  else
+    wave_index = 0;
+
+  /* determine the phase where the wave turns negative */
+  if ((type == OSC_WAVEFORM_SQUARE) || 
+      (type == OSC_WAVEFORM_SAW)    || 
+      (type == OSC_WAVEFORM_TRIANGLE))
+  {
+    threshold = 512;
+  }
+  else if (type == OSC_WAVEFORM_PULSE_1_8)
+    threshold = 128;
+  else if (type == OSC_WAVEFORM_PULSE_1_4)
+    threshold = 256;
+  else if (type == OSC_WAVEFORM_PULSE_3_8)
+    threshold = 384;
+  else if (type == OSC_WAVEFORM_PULSE_1_16)
+    threshold = 64;
+  else if (type == OSC_WAVEFORM_PULSE_3_16)
+    threshold = 192;
+  else if (type == OSC_WAVEFORM_PULSE_5_16)
+    threshold = 320;
+  else if (type == OSC_WAVEFORM_PULSE_7_16)
+    threshold = 448;
+  else
+    threshold = 1024;
+
+  /* pack the wave index with the sign in the low bit */
+  if (phase < threshold)
+    return (short int) (wave_index << 1);
+  else
+    return (short int) ((wave_index << 1) | 1);
+}
+
+/*******************************************************************************
+** tabgen_generate_waveform()
+*******************************************************************************/
+static short int tabgen_generate_waveform()
+{
+  int     i;
+  int     k;
+  double  val;
+
+  unsigned int lfsr;
+
+  /* ym2612 - 10 bit envelope (shifted to 12 bit), 12 bit sine, 13 bit sum    */
+  /* 10 bit db: 24, 12, 6, 3, 1.5, 0.75, 0.375, 0.1875, 0.09375, 0.046875     */
+  /* 12 bit db: adds on 0.0234375, 0.01171875 in back                         */
+  /* 13 bit db: adds on 48 in front                                           */
+
+  /* db to linear scale conversion */
+  S_db_to_linear[0] = 32767;
+
+  for (i = 1; i < 8191; i++)
+  {
+    S_db_to_linear[i] = 
+      (short int) ((32767.0f * exp(-log(10) * (DB_STEP / 10) * i)) + 0.5f);
+  }
+
+  S_db_to_linear[8191] = 0;
+
+  /* wavetable (sawtooth) */
+  S_wavetable_saw[0] = 4095;
+  S_wavetable_saw[512] = 0;
+
+  for (i = 1; i < 512; i++)
+  {
+    val = i / 512.0f;
+    S_wavetable_saw[i] = (short int) ((10 * (log(1 / val) / log(10)) / DB_STEP) + 0.5f);
+    S_wavetable_saw[1024 - i] = S_wavetable_saw[i];
+  }
+
+  /* wavetable (triangle) */
+  S_wavetable_tri[0] = 4095;
+  S_wavetable_tri[256] = 0;
+
+  for (i = 1; i < 256; i++)
+  {
+    val = i / 256.0f;
+    S_wavetable_tri[i] = (short int) ((10 * (log(1 / val) / log(10)) / DB_STEP) + 0.5f);
+    S_wavetable_tri[512 - i] = S_wavetable_tri[i];
+  }
+
+  /* wave mix (linear weights) */
+  S_wave_mix_linear[0] = 4096;
+
+  for (i = 1; i < 32; i++)
+  {
+    val = i / 32.0f;
+    S_wave_mix_linear[i] = (short int) ((10 * (log(1 / val) / log(10)) / DB_STEP) + 0.5f);
+  }
+
+  S_wave_mix_linear[32] = 0;
+
+  /* the geometric tables are used to perform wave mixing with ring mod       */
+  /* each sample in the original wavetable is raised to the 1/32 power        */
+  /* note that the two waveforms are mixed with the expression (x^w1)(y^w2),  */
+  /* where w1 and w2 are weights in the form 0/32, 1/32, ..., 32/32.          */
+
+  /* wavetable (sawtooth) - geometric */
+  S_geometric_saw[0] = 4095;
+  S_geometric_saw[512] = 0;
+
+  for (i = 1; i < 512; i++)
+  {
+    val = i / 512.0f;
+    val = pow(val, 0.03125f);
+
+    S_geometric_saw[i] = (short int) ((10 * (log(1 / val) / log(10)) / DB_STEP) + 0.5f);
+    S_geometric_saw[1024 - i] = S_geometric_saw[i];
+  }
+
+  /* wavetable (triangle) - geometric */
+  S_geometric_tri[0] = 4095;
+  S_geometric_tri[256] = 0;
+
+  for (i = 1; i < 256; i++)
+  {
+    val = i / 256.0f;
+    val = pow(val, 0.03125f);
+
+    S_geometric_tri[i] = (short int) ((10 * (log(1 / val) / log(10)) / DB_STEP) + 0.5f);
+    S_geometric_tri[512 - i] = S_geometric_tri[i];
+  }
+
+  /* packed wave tables, one row per waveform (the last row is silence) */
+  for (i = 0; i < 1024; i++)
+  {
+    for (k = 0; k < WAVEFORM_NUM_TYPES; k++)
+    {
+      S_wave_table[k][i] = 
+        tabgen_wave_entry(k, i, S_wavetable_saw, S_wavetable_tri);
+      S_ringmod_table[k][i] = 
+        tabgen_wave_entry(k, i, S_geometric_saw, S_geometric_tri);
+    }
+
+    S_wave_table[WAVEFORM_NUM_TYPES][i] = 0;
+    S_ringmod_table[WAVEFORM_NUM_TYPES][i] = 0;
+  }
+
+  /* noise table: output bit of the 15-bit lfsr at each step, starting */
+  /* from 0x0001 (taps on 1 and 2, as on the nes)                      */
+  lfsr = 0x0001;
+
+  for (i = 0; i < WAVEFORM_NOISE_PERIOD; i++)
+  {
+    S_noise_table[i] = lfsr & 0x0001;
+
+    if ((lfsr & 0x0001) ^ ((lfsr & 0x0002) >> 1))
+      lfsr = ((lfsr >> 1) & 0x3FFF) | 0x4000;
+    else
+      lfsr = (lfsr >> 1) & 0x3FFF;
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** tabgen_generate_lfo()
+*******************************************************************************/
+static short int tabgen_generate_lfo()
+{
+  int i;
+  int k;
+
+  /* vibrato tables */
+
+  /* depth  0: amplitude is   0 */
+  /* depth  1: amplitude is   2 */
+  /* depth  2: amplitude is   4 */
+  /* depth  3: amplitude is   6 */
+  /* depth  4: amplitude is   8 */
+  /* depth  5: amplitude is  10 */
+  /* depth  6: amplitude is  12 */
+  /* depth  7: amplitude is  16 */
+  /* depth  8: amplitude is  20 */
+  /* depth  9: amplitude is  24 */
+  /* depth 10: amplitude is  28 */
+  /* depth 11: amplitude is  32 */
+  /* depth 12: amplitude is  40 */
+  /* depth 13: amplitude is  48 */
+  /* depth 14: amplitude is  56 */
+  /* depth 15: amplitude is  64 */
+
+  /* generate vibrato waves at depth 15 */
+  for (k = 0; k < 128; k++)
+  {
+    /* sine */
+    S_vib_table[0][15][k] = (short int) ((sin(TWO_PI * k / 128.0f) * 64) + 0.5f);
+  }
+
+  for (k = 0; k < 64; k++)
+  {
+    /* square */
+    S_vib_table[1][15][k] = 64;
+    S_vib_table[1][15][k + 64] = -64;
+
+    /* saw */
+    S_vib_table[2][15][k] = k;
+    S_vib_table[2][15][k + 64] = k - 64;
+  }
+
+  for (k = 0; k < 32; k++)
+  {
+    /* triangle */
+    S_vib_table[3][15][k] = 2 * k;
+    S_vib_table[3][15][k + 32] = 64 - (2 * k);
+    S_vib_table[3][15][k + 64] = -(2 * k);
+    S_vib_table[3][15][k + 96] = -(64 - (2 * k));
+  }
+
+  /* generate waves at other depths */
+  for (i = 0; i < 4; i++)
+  {
+    for (k = 0; k < 128; k++)
+    {
+      S_vib_table[i][0][k] = 0;
+
+      S_vib_table[i][1][k] = S_vib_table[i][15][k] / 32;
+      S_vib_table[i][2][k] = S_vib_table[i][15][k] / 16;
+      S_vib_table[i][3][k] = (3 * S_vib_table[i][15][k]) / 32;
+      S_vib_table[i][4][k] = S_vib_table[i][15][k] / 8;
+      S_vib_table[i][5][k] = (5 * S_vib_table[i][15][k]) / 32;
+      S_vib_table[i][6][k] = (3 * S_vib_table[i][15][k]) / 16;
+      S_vib_table[i][7][k] = S_vib_table[i][15][k] / 4;
+      S_vib_table[i][8][k] = (5 * S_vib_table[i][15][k]) / 16;
+      S_vib_table[i][9][k] = (3 * S_vib_table[i][15][k]) / 8;
+      S_vib_table[i][10][k] = (7 * S_vib_table[i][15][k]) / 16;
+      S_vib_table[i][11][k] = S_vib_table[i][15][k] / 2;
+      S_vib_table[i][12][k] = (5 * S_vib_table[i][15][k]) / 8;
+      S_vib_table[i][13][k] = (3 * S_vib_table[i][15][k]) / 4;
+      S_vib_table[i][14][k] = (7 * S_vib_table[i][15][k]) / 8;
+    }
+  }
+
+  /* tremolo tables */
+
+  /* depth  0: amplitude is   0 */
+  /* depth  1: amplitude is  16 */
+  /* depth  2: amplitude is  24 */
+  /* depth  3: amplitude is  32 */
+  /* depth  4: amplitude is  40 */
+  /* depth  5: amplitude is  48 */
+  /* depth  6: amplitude is  56 */
+  /* depth  7: amplitude is  64 */
+  /* depth  8: amplitude is  72 */
+  /* depth  9: amplitude is  80 */
+  /* depth 10: amplitude is  88 */
+  /* depth 11: amplitude is  96 */
+  /* depth 12: amplitude is 104 */
+  /* depth 13: amplitude is 112 */
+  /* depth 14: amplitude is 120 */
+  /* depth 15: amplitude is 128 */
+
+  /* generate waves at depth 15 */
+  for (k = 0; k < 64; k++)
+  {
+    /* square */
+    S_trem_table[1][15][k] = 0;
+    S_trem_table[1][15][k + 64] = 128;
+
+    /* triangle */
+    S_trem_table[3][15][k] = 2 * k;
+    S_trem_table[3][15][k + 64] = 128 - (2 * k);
+  }
+
+  for (k = 0; k < 128; k++)
+  {
+    /* sine */
+    S_trem_table[0][15][k] = (short int) (((1.0f - cos(TWO_PI * k / 128.0f)) * 64) + 0.5f);
+
+    /* saw */
+    S_trem_table[2][15][k] = k;
+  }
+
+  /* generate waves at other depths */
+  for (i = 0; i < 4; i++)
+  {
+    for (k = 0; k < 128; k++)
+    {
+      S_trem_table[i][0][k] = 0;
+
+      S_trem_table[i][1][k] = S_trem_table[i][15][k] / 8;
+      S_trem_table[i][2][k] = (3 * S_trem_table[i][15][k]) / 16;
+      S_trem_table[i][3][k] = S_trem_table[i][15][k] / 4;
+      S_trem_table[i][4][k] = (5 * S_trem_table[i][15][k]) / 16;
+      S_trem_table[i][5][k] = (3 * S_trem_table[i][15][k]) / 8;
+      S_trem_table[i][6][k] = (7 * S_trem_table[i][15][k]) / 16;
+      S_trem_table[i][7][k] = S_trem_table[i][15][k] / 2;
+      S_trem_table[i][8][k] = (9 * S_trem_table[i][15][k]) / 16;
+      S_trem_table[i][9][k] = (5 * S_trem_table[i][15][k]) / 8;
+      S_trem_table[i][10][k] = (11 * S_trem_table[i][15][k]) / 16;
+      S_trem_table[i][11][k] = (3 * S_trem_table[i][15][k]) / 4;
+      S_trem_table[i][12][k] = (13 * S_trem_table[i][15][k]) / 16;
+      S_trem_table[i][13][k] = (7 * S_trem_table[i][15][k]) / 8;
+      S_trem_table[i][14][k] = (15 * S_trem_table[i][15][k]) / 16;
+    }
+  }
+
+  /* wobble tables */
+
+  /* depth  0: amplitude is   0 */
+  /* depth  1: amplitude is  32 */
+  /* depth  2: amplitude is  48 */
+  /* depth  3: amplitude is  64 */
+  /* depth  4: amplitude is  80 */
+  /* depth  5: amplitude is  96 */
+  /* depth  6: amplitude is 112 */
+  /* depth  7: amplitude is 128 */
+  /* depth  8: amplitude is 144 */
+  /* depth  9: amplitude is 160 */
+  /* depth 10: amplitude is 176 */
+  /* depth 11: amplitude is 192 */
+  /* depth 12: amplitude is 208 */
+  /* depth 13: amplitude is 224 */
+  /* depth 14: amplitude is 240 */
+  /* depth 15: amplitude is 256 */
+
+  /* generate wobble waves at depth 15 */
+  for (k = 0; k < 128; k++)
+  {
+    /* sine */
+    S_wob_table[0][15][k] = (short int) ((sin(TWO_PI * k / 128.0f) * 256) + 0.5f);
+  }
+
+  for (k = 0; k < 64; k++)
+  {
+    /* square */
+    S_wob_table[1][15][k] = 256;
+    S_wob_table[1][15][k + 64] = -256;
+
+    /* saw */
+    S_wob_table[2][15][k] = 4 * k;
+    S_wob_table[2][15][k + 64] = (4 * k) - 256;
+  }
+
+  for (k = 0; k < 32; k++)
+  {
+    /* triangle */
+    S_wob_table[3][15][k] = 8 * k;
+    S_wob_table[3][15][k + 32] = 256 - (8 * k);
+    S_wob_table[3][15][k + 64] = -(8 * k);
+    S_wob_table[3][15][k + 96] = -(256 - (8 * k));
+  }
+
+  /* generate waves at other depths */
+  for (i = 0; i < 4; i++)
+  {
+    for (k = 0; k < 128; k++)
+    {
+      S_wob_table[i][0][k] = 0;
+
+      S_wob_table[i][1][k] = S_wob_table[i][15][k] / 8;
+      S_wob_table[i][2][k] = (3 * S_wob_table[i][15][k]) / 16;
+      S_wob_table[i][3][k] = S_wob_table[i][15][k] / 4;
+      S_wob_table[i][4][k] = (5 * S_wob_table[i][15][k]) / 16;
+      S_wob_table[i][5][k] = (3 * S_wob_table[i][15][k]) / 8;
+      S_wob_table[i][6][k] = (7 * S_wob_table[i][15][k]) / 16;
+      S_wob_table[i][7][k] = S_wob_table[i][15][k] / 2;
+      S_wob_table[i][8][k] = (9 * S_wob_table[i][15][k]) / 16;
+      S_wob_table[i][9][k] = (5 * S_wob_table[i][15][k]) / 8;
+      S_wob_table[i][10][k] = (11 * S_wob_table[i][15][k]) / 16;
+      S_wob_table[i][11][k] = (3 * S_wob_table[i][15][k]) / 4;
+      S_wob_table[i][12][k] = (13 * S_wob_table[i][15][k]) / 16;
+      S_wob_table[i][13][k] = (7 * S_wob_table[i][15][k]) / 8;
+      S_wob_table[i][14][k] = (15 * S_wob_table[i][15][k]) / 16;
+    }
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** tabgen_generate_shaping()
+*******************************************************************************/
+static short int tabgen_generate_shaping()
+{
+  int   i;
+
+  float val;
+
+  /* hyperbolic tangent                           */
+  /* note: if tanh x is multiplied by 1/tanh(1),  */
+  /* the interval [-1, 1] maps to [-1, 1]         */
+  /* also, 1/tanh(1) = 1.313035285499331f         */
+  for (i = 0; i < 8192; i++)
+  {
+    val = 1.313035285499331f * tanhf(i / 8192.0f);
+
+    S_waveshaper_tanh_table[i] = 
+      (int) ((32767 * val) + 0.5f);
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** tabgen_generate_sequence()
+*******************************************************************************/
+static short int tabgen_generate_sequence()
+{
+  int   i;
+  int   j;
+  int   k;
+  float val;
+
+  /* sequencer period table */
+  for (i = 0; i < 224; i++)
+  {
+    val = 60.0f / ((i + 32) * SEQUENCER_TICKS_PER_QUARTER_NOTE);
+
+    S_sequencer_period_table[i] = (int) ((val * 1000000000) + 0.5f);
+  }
+
+  /* scale table */
+
+  /* set tonic notes in octave 4 */
+  for (i = 0; i < 84; i++)
+  {
+    S_scale_table[i][0][21]   = 60; /* C  */
+    S_scale_table[i][1][21]   = 61; /* C# */
+    S_scale_table[i][2][21]   = 59; /* Cb */
+
+    S_scale_table[i][3][22]   = 62; /* D  */
+    S_scale_table[i][4][22]   = 63; /* D# */
+    S_scale_table[i][5][22]   = 61; /* Db */
+
+    S_scale_table[i][6][23]   = 64; /* E  */
+    S_scale_table[i][7][23]   = 65; /* E# */
+    S_scale_table[i][8][23]   = 63; /* Eb */
+
+    S_scale_table[i][9][24]   = 65; /* F  */
+    S_scale_table[i][10][24]  = 66; /* F# */
+    S_scale_table[i][11][24]  = 64; /* Fb */
+
+    S_scale_table[i][12][25]  = 67; /* G  */
+    S_scale_table[i][13][25]  = 68; /* G# */
+    S_scale_table[i][14][25]  = 66; /* Gb */
+
+    S_scale_table[i][15][26]  = 69; /* A  */
+    S_scale_table[i][16][26]  = 70; /* A# */
+    S_scale_table[i][17][26]  = 68; /* Ab */
+
+    S_scale_table[i][18][27]  = 71; /* B  */
+    S_scale_table[i][19][27]  = 72; /* B# */
+    S_scale_table[i][20][27]  = 70; /* Bb */
+  }
+
+  /* generate one octave of each scale from the tonic */
+  for (i = 0; i < 84; i++)
+  {
+    for (j = 0; j < 21; j++)
+    {
+      for (k = 0; k < 7; k++)
+      {
+        S_scale_table[i][j][k + (j / 3) + 21 + 1] = 
+          S_scale_table[i][j][k + (j / 3) + 21] + S_scale_semitone_jump_pattern[i / 7][(k + i) % 7];
+      }
+    }
+  }
+
+  /* compute rest of each scale in the other octaves */
+  for (i = 0; i < 84; i++)
+  {
+    for (j = 0; j < 21; j++)
+    {
+      for (k = 0; k < 7; k++)
+      {
+        if (-7 + (j / 3) + k >= 0)
+          S_scale_table[i][j][-7 + (j / 3) + k] = S_scale_table[i][j][21 + (j / 3) + k] - 48;
+
+        S_scale_table[i][j][ 0 + (j / 3) + k] = S_scale_table[i][j][21 + (j / 3) + k] - 36;
+        S_scale_table[i][j][ 7 + (j / 3) + k] = S_scale_table[i][j][21 + (j / 3) + k] - 24;
+        S_scale_table[i][j][14 + (j / 3) + k] = S_scale_table[i][j][21 + (j / 3) + k] - 12;
+
+        S_scale_table[i][j][28 + (j / 3) + k] = S_scale_table[i][j][21 + (j / 3) + k] + 12;
+        S_scale_table[i][j][35 + (j / 3) + k] = S_scale_table[i][j][21 + (j / 3) + k] + 24;
+
+        if (42 + (j / 3) + k < 49)
+          S_scale_table[i][j][42 + (j / 3) + k] = S_scale_table[i][j][21 + (j / 3) + k] + 36;
+      }
+    }
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** tabgen_generate_tuning()
+*******************************************************************************/
+static short int tabgen_generate_tuning()
+{
+  int     i;
+
+  float   val;
+
+  /* compute resonance table */
+
+  /* see Vadim Zavalishin's "The Art of VA Filter Design"               */
+  /* The values in the table are for K, which is in the interval [0, 2) */
+  /* In Section 4.2, p. 103, there is a formula for R (the resonance    */
+  /* parameter for the SVF) based on the resonance peak height A:       */
+  /*   R = sqrt((1 - sqrt(1 - A^-2))/2)                                 */
+  /* Here, we are computing K values for the TSK filter. As shown in    */
+  /* Section 5.8, p. 152, we have 2R = 2 - K.                           */
+  /* So, plugging the first equation into the second, we obtain:        */
+  /*   K = 2 - sqrt(2[1 - sqrt(1 - A^-2)])                              */
+  for (i = 0; i < 32; i++)
+  {
+    val = exp(log(10) * i / 32.0f);
+
+    S_resonance_table[i] = 2 - sqrt(2 - (2 * sqrt(1 - (1 / (val * val)))));
+
+    S_resonance_fixed_table[i] = 
+      (int) ((S_resonance_table[i] * (1 << TUNING_FILTER_FIXED_BITS)) + 0.5f);
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+** tabgen_print_values()
+*******************************************************************************/
+static void tabgen_print_values(int type, void* data, int offset, 
+                                int* dims, int num_dims, int level)
+{
+  int i;
+  int stride;
+
+  /* number of values in each element at this level */
+  stride = 1;
+
+  for (i = level + 1; i < num_dims; i++)
+    stride *= dims[i];
+
+  printf("%*s{", 2 * level + 2, "");
+
+  for (i = 0; i < dims[level]; i++)
+  {
+    /* nested array */
+    if (level < num_dims - 1)
+    {
+      printf("\n");
+      tabgen_print_values(type, data, offset + i * stride, 
+                          dims, num_dims, level + 1);
+
+      if (i < dims[level] - 1)
+        printf(",");
+
+      continue;
+    }
+
+    /* values, eight per line */
+    if (i % 8 == 0)
+      printf("\n%*s", 2 * level + 4, "");
+    else
+      printf(" ");
+
+    if (type == TABGEN_TYPE_CHAR)
+      printf("%d", ((char*) data)[offset + i]);
+    else if (type == TABGEN_TYPE_SHORT)
+      printf("%d", ((short int*) data)[offset + i]);
+    else if (type == TABGEN_TYPE_INT)
+      printf("%d", ((int*) data)[offset + i]);
+    else if (type == TABGEN_TYPE_FLOAT)
+      printf("%.9ef", ((float*) data)[offset + i]);
+
+    if (i < dims[level] - 1)
+      printf(",");
+  }
+
+  printf("\n%*s}", 2 * level + 2, "");
+}
+
+/*******************************************************************************
+** tabgen_print_table()
+*******************************************************************************/
+static void tabgen_print_table(char* declaration, int type, void* data, 
+                              int dim_1, int dim_2, int dim_3)
+{
+  int dims[3];
+  int num_dims;
+
+  dims[0] = dim_1;
+  dims[1] = dim_2;
+  dims[2] = dim_3;
+
+  if (dim_2 == 0)
+    num_dims = 1;
+  else if (dim_3 == 0)
+    num_dims = 2;
+  else
+    num_dims = 3;
+
+  printf("%s = \n", declaration);
+  tabgen_print_values(type, data, 0, dims, num_dims, 0);
+  printf(";\n\n");
+}
+
+/*******************************************************************************
+** main()
+*******************************************************************************/
+int main(int argc, char *argv[])
+{
+  char* module;
+
+  if (argc != 2)
+  {
+    fprintf(stderr, "Usage: tabgen <module>\n");
+    return 1;
+  }
+
+  module = argv[1];
+
+  printf("/* %s_tables.h - generated by tabgen, do not edit */\n\n", module);
+
+  if (!strcmp(module, "waveform"))
+  {
+    tabgen_generate_waveform();
+
+    tabgen_print_table( "static const short int S_db_to_linear[8192]", 
+                        TABGEN_TYPE_SHORT, S_db_to_linear, 8192, 0, 0);
+
+    tabgen_print_table( "static const short int S_wave_mix_linear[33]", 
+                        TABGEN_TYPE_SHORT, S_wave_mix_linear, 33, 0, 0);
+
+    tabgen_print_table( "static const short int S_wave_table[11][1024]", 
+                        TABGEN_TYPE_SHORT, S_wave_table, 
+                        WAVEFORM_NUM_TYPES + 1, 1024, 0);
+    tabgen_print_table( "static const short int S_ringmod_table[11][1024]", 
+                        TABGEN_TYPE_SHORT, S_ringmod_table, 
+                        WAVEFORM_NUM_TYPES + 1, 1024, 0);
+
+    tabgen_print_table( "const char G_noise_table[32767]", 
+                        TABGEN_TYPE_CHAR, S_noise_table, 
+                        WAVEFORM_NOISE_PERIOD, 0, 0);
+  }
+  else if (!strcmp(module, "lfo"))
+  {
+    tabgen_generate_lfo();
+
+    tabgen_print_table( "static const short int S_vib_table[4][16][128]", 
+                        TABGEN_TYPE_SHORT, S_vib_table, 4, 16, 128);
+    tabgen_print_table( "static const short int S_trem_table[4][16][128]", 
+                        TABGEN_TYPE_SHORT, S_trem_table, 4, 16, 128);
+    tabgen_print_table( "static const short int S_wob_table[4][16][128]", 
+                        TABGEN_TYPE_SHORT, S_wob_table, 4, 16, 128);
+  }
+  else if (!strcmp(module, "shaping"))
+  {
+    tabgen_generate_shaping();
+
+    tabgen_print_table( "const int G_waveshaper_tanh_table[8192]", 
+                        TABGEN_TYPE_INT, S_waveshaper_tanh_table, 8192, 0, 0);
+  }
+  else if (!strcmp(module, "sequence"))
+  {
+    tabgen_generate_sequence();
+
+    tabgen_print_table( "const int G_sequencer_period_table[224]", 
+                        TABGEN_TYPE_INT, S_sequencer_period_table, 224, 0, 0);
+    tabgen_print_table( "static const char S_scale_table[84][21][49]", 
+                        TABGEN_TYPE_CHAR, S_scale_table, 84, 21, 49);
+  }
+  else if (!strcmp(module, "tuning"))
+  {
+    tabgen_generate_tuning();
+
+    tabgen_print_table( "const float G_resonance_table[32]", 
+                        TABGEN_TYPE_FLOAT, S_resonance_table, 32, 0, 0);
+    tabgen_print_table( "const int G_resonance_fixed_table[32]", 
+                        TABGEN_TYPE_INT, S_resonance_fixed_table, 32, 0, 0);
+  }
+  else
+  {
+    fprintf(stderr, "Unknown module %s.\n", module);
+    return 1;
+  }
+
+  return 0;
+}